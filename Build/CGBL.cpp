@@ -2,6 +2,11 @@
 #include "CGBL.h"
 #include "Cmdline.h"
 #include "Util.h"
+#include "Plan.h"
+#include "Scaler.h"
+#include "Subset.h"
+
+#include <QThread>
 
 
 /* --------------------------------------------------------------- */
@@ -32,14 +37,50 @@ static void PrintUsage()
     Log() << "Parameters:";
     Log() << "-create_cal     ;scan NI devices and create calibration files";
     Log() << "-apply          ;use calibration files to correct SpikeGLX NI data";
+    Log() << "-verify_crc=path;check bins in path against their .crc sidecars";
     Log() << "-cal_dir=path   ;where to put/get calibration files";
     Log() << "-src_dir=path   ;if applying, directory with nidq.bin/meta files to fix";
     Log() << "-dst_dir=path   ;if applying, where to put fixed nidq.bin/meta files";
+    Log() << "-in_place       ;if applying, fix src files in place (no dst_dir)";
+    Log() << "-stream=meta    ;apply to stdin -> stdout, using this metafile";
     Log() << "-dev1=new_name  ;optional new name of dev1 if moved or renamed since run";
     Log() << "-dev2=new_name  ;optional new name of dev2 if moved or renamed since run";
+    Log() << "-kernel=name    ;optional scaling method {lut (default), simd, fixed, adaptive, poly}";
+    Log() << "-io=name        ;optional I/O engine {pipe (default), serial, mmap, uring, direct}";
+    Log() << "-threads=N      ;optional worker threads per file (default 1, 0=all cores; -io=pipe or direct)";
+    Log() << "-compress       ;optional, write compressed .cbin/.ch (mtscomp format) not .bin";
+    Log() << "-verify_src     ;optional, check src bins against meta fileSHA1 while scaling";
+    Log() << "-crc            ;optional, write per-chunk CRC32C sidecar (.crc) with each bin";
+    Log() << "-t0=T           ;optional, scale from time T secs (or samples if 'Nsmp'), default 0";
+    Log() << "-t1=T           ;optional, scale to time T secs (or samples if 'Nsmp'), default end";
+    Log() << "-chans=range    ;optional, write only these channels (acquired ids, like 0:7,16)";
     Log() << "------------------------\n";
 }
 
+
+// Secs (12.5), or samples (300000smp).
+//
+static bool okTime( const QString &s )
+{
+    bool    ok;
+
+    if( s.endsWith( "smp" ) )
+        QString(s).remove( "smp" ).toLongLong( &ok );
+    else
+        s.toDouble( &ok );
+
+    return ok;
+}
+
+
+static qint64 time2smp( const QString &s, double srate )
+{
+    if( s.endsWith( "smp" ) )
+        return QString(s).remove( "smp" ).toLongLong();
+
+    return qRound64( s.toDouble() * srate );
+}
+
 /* ---------------------------------------------------------------- */
 /* CGBL ----------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -62,10 +103,39 @@ bool CGBL::SetCmdLine( int argc, char* argv[] )
             dev1 = sarg;
         else if( GetArgStr( sarg, "-dev2=", argv[i] ) )
             dev2 = sarg;
+        else if( GetArgStr( sarg, "-kernel=", argv[i] ) )
+            kernel = QString(sarg).toLower();
+        else if( GetArgStr( sarg, "-io=", argv[i] ) )
+            io = QString(sarg).toLower();
+        else if( GetArg( &threads, "-threads=%d", argv[i] ) ) {
+
+            if( threads <= 0 )
+                threads = QThread::idealThreadCount();
+        }
         else if( IsArg( "-create_cal", argv[i] ) )
             create = true;
         else if( IsArg( "-apply", argv[i] ) )
             apply = true;
+        else if( IsArg( "-in_place", argv[i] ) )
+            in_place = true;
+        else if( IsArg( "-compress", argv[i] ) )
+            compress = true;
+        else if( IsArg( "-verify_src", argv[i] ) )
+            verify_src = true;
+        else if( IsArg( "-crc", argv[i] ) )
+            crc = true;
+        else if( GetArgStr( sarg, "-verify_crc=", argv[i] ) )
+            verify_crc = trim_adjust_slashes( sarg );
+        else if( GetArgStr( sarg, "-t0=", argv[i] ) )
+            t0 = QString(sarg).trimmed().toLower();
+        else if( GetArgStr( sarg, "-t1=", argv[i] ) )
+            t1 = QString(sarg).trimmed().toLower();
+        else if( GetArgStr( sarg, "-chans=", argv[i] ) )
+            chans = QString(sarg).trimmed();
+        else if( GetArgStr( sarg, "-stream=", argv[i] ) ) {
+            stream  = QString(sarg).trimmed().replace( "\\", "/" );
+            apply   = true;
+        }
         else {
             Log() <<
             QString("Unknown option or wrong param count for option '%1'.")
@@ -76,25 +146,92 @@ bool CGBL::SetCmdLine( int argc, char* argv[] )
 
 // Check args
 
-    if( !create && !apply ) {
-        Log() << "Error: Missing action indicator {-create_cal, -apply}.";
+    if( !create && !apply && verify_crc.isEmpty() ) {
+        Log() << "Error: Missing action indicator"
+                 " {-create_cal, -apply, -verify_crc}.";
         goto error;
     }
 
-    if( cal_dir.isEmpty() ) {
+    if( (create || apply) && cal_dir.isEmpty() ) {
         Log() << "Error: Missing -cal_dir.";
         goto error;
     }
 
-    if( apply ) {
+    if( apply && stream.isEmpty() ) {
 
         if( src_dir.isEmpty() ) {
             Log() << "Error: Missing -src_dir.";
             goto error;
         }
 
-        if( dst_dir.isEmpty() ) {
+        if( in_place ) {
+
+            if( !dst_dir.isEmpty() && dst_dir != src_dir ) {
+                Log() << "Error: -in_place and -dst_dir are exclusive.";
+                goto error;
+            }
+
+            dst_dir = src_dir;
+        }
+        else if( dst_dir.isEmpty() ) {
             Log() << "Error: Missing -dst_dir.";
+            goto error;
+        }
+    }
+
+    if( apply ) {
+
+        if( compress && (in_place || !stream.isEmpty()) ) {
+            Log() << "Error: -compress needs -dst_dir (not -in_place or -stream).";
+            goto error;
+        }
+
+        if( crc && (compress || !stream.isEmpty()) ) {
+            Log() << "Error: -crc needs .bin output (not -compress or -stream).";
+            goto error;
+        }
+
+        if( hasWindow() && (in_place || !stream.isEmpty()) ) {
+            Log() << "Error: -t0/-t1 need -dst_dir (not -in_place or -stream).";
+            goto error;
+        }
+
+        if( (!t0.isEmpty() && !okTime( t0 ))
+            || (!t1.isEmpty() && !okTime( t1 )) ) {
+
+            Log() << "Error: -t0/-t1 must be secs or samples, like 12.5 or 300000smp.";
+            goto error;
+        }
+
+        if( !chans.isEmpty() ) {
+
+            QBitArray   b;
+
+            if( in_place || !stream.isEmpty() ) {
+                Log() << "Error: -chans needs -dst_dir (not -in_place or -stream).";
+                goto error;
+            }
+
+            if( !Subset::rngStr2Bits( b, chans ) || b.count( true ) == 0 ) {
+                Log() << "Error: -chans must be a channel range, like 0:7,16.";
+                goto error;
+            }
+        }
+
+        if( threads > 1
+            && (io == "serial" || io == "mmap" || io == "uring") ) {
+
+            Log() << "Error: -threads needs -io=pipe or direct (not serial, mmap or uring).";
+            goto error;
+        }
+
+        if( Plan::name2Kernel( kernel ) < 0 ) {
+            Log() << QString("Error: Unknown -kernel=%1.").arg( kernel );
+            goto error;
+        }
+
+        if( Scaler::name2Engine( io ) < 0 ) {
+            Log() << QString("Error: Unknown -io=%1.").arg( io );
 error:
             PrintUsage();
             return false;
@@ -111,19 +248,59 @@ error:
     if( apply )
         sCmd += " -apply";
 
-    sCmd += " -cal_dir=" + cal_dir;
+    if( create || apply )
+        sCmd += " -cal_dir=" + cal_dir;
 
     if( apply ) {
-        sCmd += " -src_dir=" + src_dir;
-        sCmd += " -dst_dir=" + dst_dir;
+
+        if( !stream.isEmpty() )
+            sCmd += " -stream=" + stream;
+        else {
+            sCmd += " -src_dir=" + src_dir;
+
+            if( in_place )
+                sCmd += " -in_place";
+            else
+                sCmd += " -dst_dir=" + dst_dir;
+        }
 
         if( !dev1.isEmpty() )
             sCmd += " -dev1=" + dev1;
 
         if( !dev2.isEmpty() )
             sCmd += " -dev2=" + dev2;
+
+        if( kernel != "lut" )
+            sCmd += " -kernel=" + kernel;
+
+        if( io != "pipe" )
+            sCmd += " -io=" + io;
+
+        if( threads != 1 )
+            sCmd += QString(" -threads=%1").arg( threads );
+
+        if( compress )
+            sCmd += " -compress";
+
+        if( verify_src )
+            sCmd += " -verify_src";
+
+        if( crc )
+            sCmd += " -crc";
+
+        if( !t0.isEmpty() )
+            sCmd += " -t0=" + t0;
+
+        if( !t1.isEmpty() )
+            sCmd += " -t1=" + t1;
+
+        if( !chans.isEmpty() )
+            sCmd += " -chans=" + chans;
     }
 
+    if( !verify_crc.isEmpty() )
+        sCmd += " -verify_crc=" + verify_crc;
+
     Log() << QString("Cmdline: %1").arg( sCmd );
 
     return true;
@@ -135,6 +312,20 @@ QString CGBL::calFile()
     return QString("%1/niscaler_cal.ini").arg( cal_dir );
 }
 
+
+// Window [w0, w1) in timepoints of a file with (ntpts) sampled
+// at (srate); times round to the nearest sample.
+//
+// Return false if empty.
+//
+bool CGBL::window( qint64 &w0, qint64 &w1, double srate, qint64 ntpts ) const
+{
+    w0 = t0.isEmpty() ? 0 : qMax( time2smp( t0, srate ), qint64(0) );
+    w1 = t1.isEmpty() ? ntpts : qMin( time2smp( t1, srate ), ntpts );
+
+    return w0 < w1;
+}
+
 /* --------------------------------------------------------------- */
 /* Private ------------------------------------------------------- */
 /* --------------------------------------------------------------- */
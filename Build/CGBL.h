@@ -15,17 +15,36 @@ public:
                 src_dir,
                 dst_dir,
                 dev1,
-                dev2;
+                dev2,
+                kernel,
+                io,
+                stream,
+                verify_crc,
+                t0,         // window, secs or "Nsmp"
+                t1,
+                chans;      // acquired ids kept, "" = all
+    int         threads;
     bool        create,
-                apply;
+                apply,
+                in_place,
+                compress,
+                verify_src,
+                crc;
 
 public:
-    CGBL() : create(false), apply(false)    {}
+    CGBL()
+    :   kernel("lut"), io("pipe"), threads(1),
+        create(false), apply(false), in_place(false),
+        compress(false), verify_src(false), crc(false)  {}
 
     bool SetCmdLine( int argc, char* argv[] );
 
     QString calFile();
 
+    bool hasWindow() const  {return !t0.isEmpty() || !t1.isEmpty();}
+    QString sWindow() const {return hasWindow() ? t0 + "," + t1 : "";}
+    bool window( qint64 &w0, qint64 &w1, double srate, qint64 ntpts ) const;
+
 private:
     QString trim_adjust_slashes( const QString &dir );
 };
@@ -0,0 +1,254 @@
+
+
+#include "Cbin.h"
+#include "Util.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <algorithm>
+
+#include <string.h>
+
+
+/* ---------------------------------------------------------------- */
+/* Cbin ----------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Chunks of (chktpts); the last may be shorter.
+//
+void Cbin::setBounds( qint64 ntpts, qint64 chktpts )
+{
+    bounds.clear();
+
+    for( qint64 t = 0; t < ntpts; t += chktpts )
+        bounds.push_back( t );
+
+    bounds.push_back( ntpts );
+}
+
+
+// The chunk table must start at zero and never decrease, and
+// must not run past the end of the .cbin (cbinBytes).
+//
+bool Cbin::fromChFile( const QString &chFile, qint64 cbinBytes )
+{
+    QFile   f( chFile );
+
+    if( !f.open( QIODevice::ReadOnly ) )
+        return false;
+
+    QJsonParseError err;
+    QJsonDocument   doc = QJsonDocument::fromJson( f.readAll(), &err );
+
+    if( err.error != QJsonParseError::NoError || !doc.isObject() )
+        return false;
+
+    QJsonObject O = doc.object();
+
+    if( O["algorithm"].toString() != "zlib"
+        || O["dtype"].toString() != "int16"
+        || O["do_spatial_diff"].toBool() ) {
+
+        return false;
+    }
+
+    srate   = O["sample_rate"].toDouble();
+    nC      = O["n_channels"].toInt();
+    level   = O["comp_level"].toInt( -1 );
+    tdiff   = O["do_time_diff"].toBool();
+    sha1c   = O["sha1_compressed"].toString();
+    sha1u   = O["sha1_uncompressed"].toString();
+
+    QJsonArray  B = O["chunk_bounds"].toArray(),
+                F = O["chunk_offsets"].toArray();
+
+    bounds.clear();
+    offsets.clear();
+
+    for( int i = 0, n = B.size(); i < n; ++i )
+        bounds.push_back( qint64(B[i].toDouble()) );
+
+    for( int i = 0, n = F.size(); i < n; ++i )
+        offsets.push_back( qint64(F[i].toDouble()) );
+
+    if( nC <= 0 || bounds.size() < 2 || offsets.size() != bounds.size() )
+        return false;
+
+    if( bounds[0] || offsets[0] || offsets.back() > cbinBytes )
+        return false;
+
+    for( int i = 1, n = bounds.size(); i < n; ++i ) {
+
+        if( bounds[i] < bounds[i - 1] || offsets[i] < offsets[i - 1] )
+            return false;
+    }
+
+    return true;
+}
+
+
+// Written to a temporary and renamed over (chFile) on success;
+// a .cbin without its .ch is incomplete.
+//
+bool Cbin::toChFile( const QString &chFile ) const
+{
+    QJsonObject O;
+    QJsonArray  B, F;
+
+    for( int i = 0, n = bounds.size(); i < n; ++i )
+        B.append( double(bounds[i]) );
+
+    for( int i = 0, n = offsets.size(); i < n; ++i )
+        F.append( double(offsets[i]) );
+
+    O["version"]            = QString("1.0");
+    O["algorithm"]          = QString("zlib");
+    O["comp_level"]         = level;
+    O["do_time_diff"]       = tdiff;
+    O["do_spatial_diff"]    = false;
+    O["dtype"]              = QString("int16");
+    O["n_channels"]         = nC;
+    O["sample_rate"]        = srate;
+    O["chunk_bounds"]       = B;
+    O["chunk_offsets"]      = F;
+    O["sha1_compressed"]    = sha1c;
+    O["sha1_uncompressed"]  = sha1u;
+
+    QSaveFile   f( chFile );
+
+    if( !f.open( QIODevice::WriteOnly ) )
+        return false;
+
+    QByteArray  json = QJsonDocument( O ).toJson( QJsonDocument::Indented );
+
+    return f.write( json ) == json.size() && f.commit();
+}
+
+
+// Encode (ntpts) of (src) into (z), using (tmp), sized like
+// (src), for the differences.
+//
+// qCompress output is a 4-byte big-endian length, then a zlib
+// stream; mtscomp stores just the stream.
+//
+void Cbin::encode(
+    QByteArray      &z,
+    qint16          *tmp,
+    const qint16    *src,
+    qint64          ntpts ) const
+{
+    qint64  nw = ntpts * nC;
+
+    if( tdiff ) {
+
+        memcpy( tmp, src, nC * sizeof(qint16) );
+
+        for( qint64 i = nC; i < nw; ++i )
+            tmp[i] = qint16(src[i] - src[i - nC]);
+
+        src = tmp;
+    }
+
+    z = qCompress( (const uchar*)src, nw * sizeof(qint16), level );
+    z.remove( 0, 4 );
+}
+
+
+// Decode chunk (z) of (zbytes) into (ntpts) at (dst).
+//
+// Return true if no errors.
+//
+bool Cbin::decode(
+    qint16          *dst,
+    qint64          ntpts,
+    const char      *z,
+    qint64          zbytes ) const
+{
+    qint64      nw      = ntpts * nC,
+                bytes   = nw * sizeof(qint16);
+    QByteArray  zq( 4, 0 );
+
+    zq[0] = char(bytes >> 24);
+    zq[1] = char(bytes >> 16);
+    zq[2] = char(bytes >> 8);
+    zq[3] = char(bytes);
+    zq.append( z, zbytes );
+
+    QByteArray  raw = qUncompress( zq );
+
+    if( raw.size() != bytes )
+        return false;
+
+    memcpy( dst, raw.constData(), bytes );
+
+    if( tdiff ) {
+
+        for( qint64 i = nC; i < nw; ++i )
+            dst[i] = qint16(dst[i] + dst[i - nC]);
+    }
+
+    return true;
+}
+
+
+// Decode timepoints [t0, t0+ntpts) of .cbin (f) into (dst), using
+// positional reads, so threads may share (f). Chunks wholly inside
+// the range decode in place; partial ones go through (tmp). (z)
+// holds compressed bytes. Callers keep (z) and (tmp) across calls.
+//
+// Return true if no errors.
+//
+bool Cbin::read(
+    QFile               &f,
+    qint16              *dst,
+    qint64              t0,
+    qint64              ntpts,
+    std::vector<char>   &z,
+    std::vector<qint16> &tmp ) const
+{
+    qint64  t1      = t0 + ntpts,
+            ichk    = std::upper_bound( bounds.begin(), bounds.end(), t0 )
+                        - bounds.begin() - 1;
+
+    if( ichk < 0 || t1 > tpts() )
+        return false;
+
+    for( ; t0 < t1; ++ichk ) {
+
+        qint64  b0      = bounds[ichk],
+                b1      = bounds[ichk + 1],
+                zbytes  = offsets[ichk + 1] - offsets[ichk],
+                hi      = qMin( t1, b1 );
+
+        z.resize( qMax( zbytes, qint64(1) ) );
+
+        if( readAt( f, &z[0], zbytes, offsets[ichk] ) != zbytes )
+            return false;
+
+        if( t0 == b0 && hi == b1 ) {
+
+            if( !decode( dst, b1 - b0, &z[0], zbytes ) )
+                return false;
+        }
+        else {
+
+            tmp.resize( (b1 - b0) * nC );
+
+            if( !decode( &tmp[0], b1 - b0, &z[0], zbytes ) )
+                return false;
+
+            memcpy( dst, &tmp[(t0 - b0) * nC], (hi - t0) * nC * sizeof(qint16) );
+        }
+
+        dst += (hi - t0) * nC;
+        t0   = hi;
+    }
+
+    return true;
+}
+
+
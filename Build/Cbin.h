@@ -0,0 +1,76 @@
+#ifndef CBIN_H
+#define CBIN_H
+
+#include <QByteArray>
+#include <QString>
+
+class QFile;
+
+#include <vector>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Chunked, lossless compressed bin: a .cbin/.ch pair compatible
+// with mtscomp (version 1.0, zlib, time differences).
+//
+// The .cbin holds the bin's timepoints cut into chunks (about one
+// second each). Every chunk is compressed on its own, so any one
+// can be decoded without the others. The .ch sidecar (JSON) holds
+// the chunk table:
+// - chunk_bounds:  [nchk+1] first timepoint of each chunk, then end.
+// - chunk_offsets: [nchk+1] first .cbin byte of each chunk, then end.
+//
+// Chunk encoding: first timepoint verbatim, then each sample less
+// the same channel's previous sample (int16, wrapping), then zlib.
+// Scaled NI channels vary slowly, so the differences are small and
+// compress well. Decoding is zlib, then a running sum.
+//
+class Cbin
+{
+public:
+    std::vector<qint64> bounds,
+                        offsets;
+    QString             sha1c,      // hex, whole .cbin
+                        sha1u;      // hex, whole decoded bin
+    double              srate;
+    int                 nC,         // words/timepoint
+                        level;      // zlib, -1 = default
+    bool                tdiff;      // time differences
+
+public:
+    Cbin() : srate(0), nC(0), level(-1), tdiff(true)  {}
+
+    qint64 nChunks() const  {return bounds.size() ? bounds.size() - 1 : 0;}
+    qint64 tpts() const     {return bounds.size() ? bounds.back() : 0;}
+
+    void setBounds( qint64 ntpts, qint64 chktpts );
+
+    bool fromChFile( const QString &chFile, qint64 cbinBytes );
+    bool toChFile( const QString &chFile ) const;
+
+    void encode(
+        QByteArray      &z,
+        qint16          *tmp,
+        const qint16    *src,
+        qint64          ntpts ) const;
+
+    bool decode(
+        qint16          *dst,
+        qint64          ntpts,
+        const char      *z,
+        qint64          zbytes ) const;
+
+    bool read(
+        QFile               &f,
+        qint16              *dst,
+        qint64              t0,
+        qint64              ntpts,
+        std::vector<char>   &z,
+        std::vector<qint16> &tmp ) const;
+};
+
+#endif  // CBIN_H
+
+
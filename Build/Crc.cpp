@@ -0,0 +1,242 @@
+
+
+#include "Crc.h"
+#include "SIMD.h"
+#include "Util.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+
+#include <algorithm>
+
+
+/* ---------------------------------------------------------------- */
+/* CrcThread ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Repeatedly claims the next chunk, reads it from (f) and checks
+// it against (C). Reads are positional, so threads share (f).
+//
+class CrcThread : public QThread
+{
+private:
+    const ChunkCrc          &C;
+    QFile                   &f;
+    QAtomicInteger<qint64>  &next;
+    QAtomicInt              &fail;
+public:
+    std::vector<qint64>     bad;
+
+public:
+    CrcThread(
+        const ChunkCrc          &C,
+        QFile                   &f,
+        QAtomicInteger<qint64>  &next,
+        QAtomicInt              &fail )
+    :   C(C), f(f), next(next), fail(fail)  {}
+
+protected:
+    virtual void run();
+};
+
+
+void CrcThread::run()
+{
+    std::vector<char>   buf( C.chunkBytes );
+    qint64              nchk = C.crcs.size();
+
+    while( !fail.load() ) {
+
+        qint64  ichk    = next.fetchAndAddOrdered( 1 );
+
+        if( ichk >= nchk )
+            break;
+
+        qint64  offset  = ichk * C.chunkBytes,
+                bytes   = qMin( C.chunkBytes, C.nbytes - offset );
+
+        if( readAt( f, &buf[0], bytes, offset ) != bytes ) {
+            fail.store( 1 );
+            break;
+        }
+
+        if( SIMD::crc32c( 0, &buf[0], bytes ) != C.crcs[ichk] )
+            bad.push_back( ichk );
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* ChunkCrc ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void ChunkCrc::reset()
+{
+    crcs.clear();
+    nbytes      = 0;
+    complete    = false;
+    cur         = 0;
+}
+
+
+void ChunkCrc::add( const char *data, qint64 bytes )
+{
+    while( bytes > 0 ) {
+
+        qint64  room    = chunkBytes - nbytes % chunkBytes,
+                n       = qMin( room, bytes );
+
+        cur     = SIMD::crc32c( cur, data, n );
+        nbytes += n;
+        data   += n;
+        bytes  -= n;
+
+        if( n == room ) {
+            crcs.push_back( cur );
+            cur = 0;
+        }
+    }
+}
+
+
+void ChunkCrc::finish()
+{
+    if( nbytes % chunkBytes ) {
+        crcs.push_back( cur );
+        cur = 0;
+    }
+
+    complete = true;
+}
+
+
+qint64 ChunkCrc::nMatching( const ChunkCrc &A, const ChunkCrc &B )
+{
+    if( A.chunkBytes != B.chunkBytes )
+        return 0;
+
+    qint64  n = qMin( A.nbytes, B.nbytes ) / A.chunkBytes;
+
+    return std::mismatch( A.crcs.begin(), A.crcs.begin() + n, B.crcs.begin() )
+            .first - A.crcs.begin();
+}
+
+
+bool ChunkCrc::fromFile( const QString &path )
+{
+    QFile   f( path );
+
+    reset();
+
+    if( !f.open( QIODevice::ReadOnly | QIODevice::Text ) )
+        return false;
+
+    QString     s = QTextStream( &f ).readAll(),
+                line;
+    QTextStream ts( &s, QIODevice::ReadOnly | QIODevice::Text );
+
+    if( ts.readLine() != "crc32c" )
+        return false;
+
+    for( int i = 0; i < 3; ++i ) {
+
+        QStringList kv = ts.readLine().split( '=' );
+
+        if( kv.size() != 2 )
+            return false;
+
+        if( kv[0] == "chunkBytes" )
+            chunkBytes = kv[1].toLongLong();
+        else if( kv[0] == "fileBytes" )
+            nbytes = kv[1].toLongLong();
+        else if( kv[0] == "complete" )
+            complete = kv[1] == "true";
+    }
+
+    while( !(line = ts.readLine()).isNull() ) {
+
+        bool    ok;
+        quint32 c = line.toUInt( &ok, 16 );
+
+        if( !ok )
+            return false;
+
+        crcs.push_back( c );
+    }
+
+    if( chunkBytes <= 0 )
+        return false;
+
+    qint64  nchk = complete ?
+                    (nbytes + chunkBytes - 1) / chunkBytes :
+                    nbytes / chunkBytes;
+
+    return qint64(crcs.size()) == nchk;
+}
+
+
+// Written to a temporary and renamed over (path).
+//
+bool ChunkCrc::toFile( const QString &path ) const
+{
+    QSaveFile   f( path );
+
+    if( !f.open( QIODevice::WriteOnly | QIODevice::Text ) )
+        return false;
+
+    qint64  nchk    = complete ? crcs.size() : nbytes / chunkBytes,
+            covered = complete ? nbytes : nchk * chunkBytes;
+    QString s       = QString("crc32c\nchunkBytes=%1\nfileBytes=%2\ncomplete=%3\n")
+                        .arg( chunkBytes )
+                        .arg( covered )
+                        .arg( complete ? "true" : "false" );
+
+    for( qint64 i = 0; i < nchk; ++i )
+        s += QString("%1\n").arg( crcs[i], 8, 16, QChar('0') ).toUpper();
+
+    QTextStream ts( &f );
+
+    ts << s;
+    ts.flush();
+
+    return ts.status() == QTextStream::Ok && f.commit();
+}
+
+
+bool ChunkCrc::verify(
+    const QString       &bin,
+    int                 nthd,
+    std::vector<qint64> &bad ) const
+{
+    QFile   f( bin );
+
+    bad.clear();
+
+    if( !f.open( QIODevice::ReadOnly | QIODevice::Unbuffered )
+        || f.size() < nbytes ) {
+
+        return false;
+    }
+
+    QAtomicInteger<qint64>      next( 0 );
+    QAtomicInt                  fail( 0 );
+    std::vector<CrcThread*>     vT;
+
+    for( int i = 0; i < qMax( nthd, 1 ); ++i ) {
+        vT.push_back( new CrcThread( *this, f, next, fail ) );
+        vT[i]->start();
+    }
+
+    for( int i = 0, n = vT.size(); i < n; ++i ) {
+        vT[i]->wait();
+        bad.insert( bad.end(), vT[i]->bad.begin(), vT[i]->bad.end() );
+        delete vT[i];
+    }
+
+    std::sort( bad.begin(), bad.end() );
+
+    return !fail.load();
+}
+
+
@@ -0,0 +1,75 @@
+#ifndef CRC_H
+#define CRC_H
+
+#include <QString>
+
+#include <vector>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// CRC32C of each (chunkBytes) of a bin, kept in a text sidecar
+// (.crc) beside it. Any chunk can be checked alone, so a reader
+// can trust the part it needs, and a whole file can be checked
+// by many threads at once.
+//
+// Sidecar: a header, then one 8-digit hex CRC per line.
+//
+//     crc32c
+//     chunkBytes=4194304
+//     fileBytes=123456789
+//     complete=true
+//     1A2B3C4D
+//     ...
+//
+// An incomplete sidecar (a checkpoint) lists only whole chunks,
+// and fileBytes is the count they cover. A complete one ends
+// with any short last chunk, and fileBytes is the bin's size.
+//
+class ChunkCrc
+{
+public:
+    enum {
+        defChunkBytes = 4*1024*1024
+    };
+
+public:
+    std::vector<quint32>    crcs;
+    qint64                  chunkBytes,
+                            nbytes;     // bytes covered
+    bool                    complete;
+private:
+    quint32                 cur;        // of partial chunk
+
+public:
+    ChunkCrc( qint64 chunkBytes = defChunkBytes )
+    :   chunkBytes(chunkBytes), nbytes(0), complete(false), cur(0)  {}
+
+    void reset();
+
+    // Append bytes in file order.
+    void add( const char *data, qint64 bytes );
+
+    // Close the short last chunk, if any.
+    void finish();
+
+    // Count of leading chunks equal in (A) and (B);
+    // 0 if chunk sizes differ.
+    static qint64 nMatching( const ChunkCrc &A, const ChunkCrc &B );
+
+    bool fromFile( const QString &path );
+    bool toFile( const QString &path ) const;
+
+    // Check the chunks of (bin) with (nthd) threads; indices of
+    // bad ones go to (bad). Caller checks (bin)'s size if need be.
+    // Return false if (bin) can't be read.
+    bool verify(
+        const QString       &bin,
+        int                 nthd,
+        std::vector<qint64> &bad ) const;
+};
+
+#endif  // CRC_H
+
+
@@ -2,6 +2,8 @@
 #include "KVParams.h"
 #include "Util.h"
 
+#include <QSaveFile>
+
 
 
 
@@ -116,17 +118,21 @@ bool KVParams::fromMetaFile( const QString &metaFile )
 }
 
 
+// Written to a temporary and renamed over (metaFile) on success,
+// so a crash never leaves a truncated metafile.
+//
 bool KVParams::toMetaFile( const QString &metaFile ) const
 {
-    QFile   f( metaFile );
+    QSaveFile   f( metaFile );
 
     if( f.open( QIODevice::WriteOnly | QIODevice::Text ) ) {
 
         QTextStream ts( &f );
 
         ts << toString();
+        ts.flush();
 
-        if( ts.status() == QTextStream::Ok )
+        if( ts.status() == QTextStream::Ok && f.commit() )
             return true;
         else {
             Error()
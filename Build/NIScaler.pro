@@ -16,22 +16,34 @@ unix {
 QT += widgets
 
 HEADERS +=              \
+    Cbin.h              \
     CGBL.h              \
     Cmdline.h           \
+    Crc.h               \
     KVParams.h          \
     NIDAQmx.h           \
+    Plan.h              \
+    Scaler.h            \
     SGLTypes.h          \
+    SIMD.h              \
     Subset.h            \
     Tool.h              \
+    Uring.h             \
     Util.h
 
 SOURCES +=              \
     main.cpp            \
+    Cbin.cpp            \
     CGBL.cpp            \
     Cmdline.cpp         \
+    Crc.cpp             \
     KVParams.cpp        \
+    Plan.cpp            \
+    Scaler.cpp          \
+    SIMD.cpp            \
     Subset.cpp          \
     Tool.cpp            \
+    Uring.cpp           \
     Util.cpp            \
     Util_osdep.cpp
 
@@ -0,0 +1,854 @@
+
+
+#include "Plan.h"
+#include "Util.h"
+#include "Subset.h"
+#include "SIMD.h"
+
+#include <QStringList>
+
+#include <map>
+
+#include <math.h>
+#include <string.h>
+
+
+#define LINEYMAX    double(1 << 29)
+
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Horner evaluation of raw sample (v) for one channel whose
+// coeffs C[0], C[stride], ... are given in ascending order.
+// Every kernel must reproduce this arithmetic exactly.
+//
+static inline double polyReal(
+    const double    *C,
+    int             stride,
+    int             ncof,
+    double          V2I,
+    int             v )
+{
+    double  V = 0.0;
+
+    for( int k = ncof - 1; k > 0; --k ) {
+        V += C[k*stride];
+        V *= v;
+    }
+
+    return V2I * (V + C[0]);
+}
+
+
+static inline qint16 poly1(
+    const double    *C,
+    int             stride,
+    int             ncof,
+    double          V2I,
+    int             v )
+{
+    return qBound( SHRT_MIN, int(polyReal( C, stride, ncof, V2I, v )), SHRT_MAX );
+}
+
+
+// Integer line-segment evaluation of raw sample (v). Inputs are
+// split into segments of 2^shift codes; G[] holds {Y0, dY/dv}
+// per segment in 2^-32 units. Truncates toward zero.
+//
+static inline qint16 line1( const qint64 *G, int shift, int v )
+{
+    uint            u = v + 32768;
+    const qint64    *S = &G[2*(u >> shift)];
+    qint64          Y = S[0] + S[1] * qint64(u & ((1 << shift) - 1));
+
+    Y += (Y >> 63) & 0xFFFFFFFFLL;
+
+    return qBound( qint64(SHRT_MIN), Y >> 32, qint64(SHRT_MAX) );
+}
+
+
+// Integer Horner evaluation of raw sample (v) for one channel.
+// A[] holds V2I*coeffs scaled to per-stage binary points F[k],
+// S[] holds the shift from stage k to k-1, and S[0] = F[0].
+// Final result truncates toward zero, as does int(double).
+//
+static inline qint16 fixed1(
+    const qint64    *A,
+    const qint32    *S,
+    int             stride,
+    int             ncof,
+    int             v )
+{
+    qint64  H = A[(ncof-1)*stride];
+
+    for( int k = ncof - 1; k > 0; --k )
+        H = ((H * v) >> S[k*stride]) + A[(k-1)*stride];
+
+    int F0 = S[0];
+
+    H += (H >> 63) & ((qint64(1) << F0) - 1);
+
+    return qBound( qint64(SHRT_MIN), H >> F0, qint64(SHRT_MAX) );
+}
+
+
+// Horner with constant degree; the compiler unrolls the k-loop.
+//
+template<int NCOF>
+static void polyDeg( const Plan &P, qint16 *d, qint64 ntpts )
+{
+    const double    *C      = &P.cof[0];
+    double          V2I     = P.V2I;
+    int             nC      = P.nC,
+                    nai     = P.nai;
+
+    for( qint64 it = 0; it < ntpts; ++it, d += nC ) {
+
+        for( int ic = 0; ic < nai; ++ic )
+            d[ic] = poly1( &C[ic], nai, NCOF, V2I, d[ic] );
+    }
+}
+
+
+// Horner with constant degree and channel layout;
+// the compiler unrolls both the k-loop and ic-loop.
+//
+template<int NCOF, int NAI, int NC>
+static void polyFix( const Plan &P, qint16 *d, qint64 ntpts )
+{
+    const double    *C      = &P.cof[0];
+    double          V2I     = P.V2I;
+
+    for( qint64 it = 0; it < ntpts; ++it, d += NC ) {
+
+        for( int ic = 0; ic < NAI; ++ic )
+            d[ic] = poly1( &C[ic], NAI, NCOF, V2I, d[ic] );
+    }
+}
+
+
+// Cubic cal polynomial with 1..8 analog channels,
+// optionally followed by one digital word.
+//
+#define POLYFIX( n )    {polyFix<4,n,n>, polyFix<4,n,n+1>}
+
+static const Plan::PolyFn polyFixTbl[8][2] = {
+    POLYFIX( 1 ), POLYFIX( 2 ), POLYFIX( 3 ), POLYFIX( 4 ),
+    POLYFIX( 5 ), POLYFIX( 6 ), POLYFIX( 7 ), POLYFIX( 8 )
+};
+
+static const Plan::PolyFn polyDegTbl[4] = {
+    polyDeg<1>, polyDeg<2>, polyDeg<3>, polyDeg<4>
+};
+
+/* ---------------------------------------------------------------- */
+/* Coeff ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+void Coeff::get( QSettings &S, const QString &grpdev )
+{
+    S.beginGroup( grpdev );
+
+    int nai = S.value( "nai", 0 ).toInt();
+
+    V.resize( nai );
+
+    for( int ic = 0; ic < nai; ++ic ) {
+
+        std::vector<double> &C = V[ic];
+
+        QStringList sl = S.value( QString("ai%1").arg( ic ) ).toStringList();
+        ncof = sl.size();
+
+        for( int k = 0; k < ncof; ++k )
+            C.push_back( sl.at( k ).toDouble() );
+    }
+
+    S.endGroup();
+}
+
+/* ---------------------------------------------------------------- */
+/* Plan ----------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Return Kernel for command line name, or -1 if unknown.
+//
+int Plan::name2Kernel( const QString &name )
+{
+    if( name == "poly" )
+        return kPoly;
+    else if( name == "lut" )
+        return kLUT;
+    else if( name == "simd" )
+        return kSIMD;
+    else if( name == "fixed" )
+        return kFixed;
+    else if( name == "adaptive" )
+        return kAdapt;
+
+    return -1;
+}
+
+
+void Plan::make( const KVParams &kvp, const Coeff &K1, const Coeff &K2 )
+{
+    std::vector<bool>   vK1;  // true if K1
+    std::vector<uint>   vai;  // physical channel
+    QVector<uint>       vi;
+    int                 kmux = kvp["niMuxFactor"].toInt();
+    int                 nv;
+    bool                dual = kvp["niDualDevMode"].toBool();
+
+    V2I = 32768 / kvp["niAiRangeMax"].toDouble();
+    nC  = kvp["nSavedChans"].toInt();
+
+// First fill {vK1, vai} with acquired NI channels
+
+// MN
+
+    QString chnstr = kvp["niMNChans1"].toString();
+
+    if( !chnstr.isEmpty() ) {
+
+        Subset::rngStr2Vec( vi, chnstr );
+
+        for( int ic = 0, nc = vi.size(); ic < nc; ++ic ) {
+
+            uint    ai = vi[ic];
+
+            for( int j = 0; j < kmux; ++j ) {
+                vK1.push_back( true );
+                vai.push_back( ai );
+            }
+        }
+    }
+
+    if( dual ) {
+
+        chnstr = kvp["niMNChans2"].toString();
+
+        if( !chnstr.isEmpty() ) {
+
+            Subset::rngStr2Vec( vi, chnstr );
+
+            for( int ic = 0, nc = vi.size(); ic < nc; ++ic ) {
+
+                uint    ai = vi[ic];
+
+                for( int j = 0; j < kmux; ++j ) {
+                    vK1.push_back( false );
+                    vai.push_back( ai );
+                }
+            }
+        }
+    }
+
+// MA
+
+    chnstr = kvp["niMAChans1"].toString();
+
+    if( !chnstr.isEmpty() ) {
+
+        Subset::rngStr2Vec( vi, chnstr );
+
+        for( int ic = 0, nc = vi.size(); ic < nc; ++ic ) {
+
+            uint    ai = vi[ic];
+
+            for( int j = 0; j < kmux; ++j ) {
+                vK1.push_back( true );
+                vai.push_back( ai );
+            }
+        }
+    }
+
+    if( dual ) {
+
+        chnstr = kvp["niMAChans2"].toString();
+
+        if( !chnstr.isEmpty() ) {
+
+            Subset::rngStr2Vec( vi, chnstr );
+
+            for( int ic = 0, nc = vi.size(); ic < nc; ++ic ) {
+
+                uint    ai = vi[ic];
+
+                for( int j = 0; j < kmux; ++j ) {
+                    vK1.push_back( false );
+                    vai.push_back( ai );
+                }
+            }
+        }
+    }
+
+// XA
+
+    chnstr = kvp["niXAChans1"].toString();
+
+    if( !chnstr.isEmpty() ) {
+
+        Subset::rngStr2Vec( vi, chnstr );
+
+        for( int ic = 0, nc = vi.size(); ic < nc; ++ic ) {
+
+            vK1.push_back( true );
+            vai.push_back( vi[ic] );
+        }
+    }
+
+    if( dual ) {
+
+        chnstr = kvp["niXAChans2"].toString();
+
+        if( !chnstr.isEmpty() ) {
+
+            Subset::rngStr2Vec( vi, chnstr );
+
+            for( int ic = 0, nc = vi.size(); ic < nc; ++ic ) {
+
+                vK1.push_back( false );
+                vai.push_back( vi[ic] );
+            }
+        }
+    }
+
+// Next copy only saved channels to plan
+
+    QBitArray   b;
+
+    chnstr  = kvp["snsSaveChanSubset"].toString();
+    nv      = vai.size();
+
+    if( Subset::isAllChansStr( chnstr ) )
+        Subset::defaultBits( b, nv );
+    else
+        Subset::rngStr2Bits( b, chnstr );
+
+    for( int ib = 0; ib < nv; ++ib ) {
+
+        if( b.testBit( ib ) ) {
+            ic2K1.push_back( vK1[ib] );
+            ic2ai.push_back( vai[ib] );
+        }
+    }
+
+    nai = ic2ai.size();
+
+// Flatten coeffs
+
+    ncof = 1;
+
+    for( int ic = 0; ic < nai; ++ic ) {
+
+        const Coeff &K = (ic2K1[ic] ? K1 : K2);
+        ncof = qMax( ncof, int(K.V[ic2ai[ic]].size()) );
+    }
+
+    cof.assign( ncof * nai, 0.0 );
+
+    for( int ic = 0; ic < nai; ++ic ) {
+
+        const std::vector<double>   &C = (ic2K1[ic] ? K1 : K2).V[ic2ai[ic]];
+
+        for( int k = 0, nk = C.size(); k < nk; ++k )
+            cof[k*nai + ic] = C[k];
+    }
+}
+
+
+// Prepare faster equivalent of applyPoly().
+// Unavailable kernels fall back to kPoly.
+//
+void Plan::compile( Kernel k )
+{
+    kernel = kPoly;
+    polyFn = 0;
+
+    switch( k ) {
+        case kPoly:
+            compilePoly();
+            break;
+        case kLUT:
+            compileLUT();
+            kernel = kLUT;
+            break;
+        case kSIMD:
+            if( compileSIMD() )
+                kernel = kSIMD;
+            break;
+        case kFixed:
+            if( compileFixed() )
+                kernel = kFixed;
+            break;
+        case kAdapt:
+            compileAdapt();
+            kernel = kAdapt;
+            break;
+        default:
+            break;
+    }
+}
+
+
+void Plan::apply( qint16 *d, qint64 ntpts ) const
+{
+    if( !nai )
+        return;
+
+    switch( kernel ) {
+        case kFixed:
+            applyFixed( d, ntpts );
+            break;
+        case kAdapt:
+            applyAdapt( d, ntpts );
+            break;
+        case kLUT:
+            applyLUT( d, ntpts );
+            break;
+        case kSIMD:
+            applySIMD( d, ntpts );
+            break;
+        default:
+            if( polyFn )
+                polyFn( *this, d, ntpts );
+            else
+                applyPoly( d, ntpts );
+            break;
+    }
+}
+
+
+// Out-of-place: scale (ntpts) timepoints of src into dst.
+//
+// Kernels work in place, so each cache-sized block of src is
+// copied to its final place in dst and scaled there while hot.
+// dst and src must not overlap.
+//
+void Plan::apply( qint16 *dst, const qint16 *src, qint64 ntpts ) const
+{
+    qint64  blktpts = qMax( 1, (16*1024) / (2 * nC) );
+
+    while( ntpts > 0 ) {
+
+        qint64  nt = qMin( blktpts, ntpts );
+
+        memcpy( dst, src, 2 * nC * nt );
+        apply( dst, nt );
+
+        dst     += nt * nC;
+        src     += nt * nC;
+        ntpts   -= nt;
+    }
+}
+
+
+// Select a Horner kernel specialized on degree, and if
+// possible, on channel layout. Other shapes use the
+// generic applyPoly().
+//
+void Plan::compilePoly()
+{
+    if( ncof == 4 && nai >= 1 && nai <= 8 && nC >= nai && nC - nai <= 1 ) {
+
+        polyFn = polyFixTbl[nai-1][nC-nai];
+
+        Log() <<
+        QString("Poly kernel: specialized {ncof %1, nai %2, nC %3}.")
+        .arg( ncof ).arg( nai ).arg( nC );
+    }
+    else if( ncof <= 4 ) {
+
+        polyFn = polyDegTbl[ncof-1];
+
+        Log() <<
+        QString("Poly kernel: specialized {ncof %1}.").arg( ncof );
+    }
+    else
+        Log() << "Poly kernel: generic.";
+}
+
+
+// Build one 64K-entry table for each distinct {Coeff table, ai}
+// referenced by the plan. Entry [quint16(v)] holds the corrected
+// value of raw sample v, evaluated exactly as applyPoly() does it,
+// so table and polynomial outputs are identical.
+//
+void Plan::compileLUT()
+{
+    std::map<uint,uint> key2off;    // {K2 ? 0x10000 : 0} + ai -> offset
+
+    lut.clear();
+    ic2lut.resize( nai );
+
+    for( int ic = 0; ic < nai; ++ic ) {
+
+        uint    key = (ic2K1[ic] ? 0 : 0x10000) + ic2ai[ic];
+
+        std::map<uint,uint>::iterator   it = key2off.find( key );
+
+        if( it != key2off.end() ) {
+            ic2lut[ic] = it->second;
+            continue;
+        }
+
+        uint    off = lut.size();
+
+        key2off[key]    = off;
+        ic2lut[ic]      = off;
+
+        lut.resize( off + 0x10000 );
+
+        for( int v = SHRT_MIN; v <= SHRT_MAX; ++v )
+            lut[off + quint16(v)] = poly1( &cof[ic], nai, ncof, V2I, v );
+    }
+}
+
+
+// Lay out coefficients for the SIMD kernels: lane j of the
+// period serves word (j % nC) of a timepoint. Digital words
+// get zero coeffs and a zero mask so they pass through.
+//
+// The chosen kernel is then checked against applyPoly() for every
+// 16-bit input on every channel; any difference rejects it.
+//
+// Return true if usable.
+//
+bool Plan::compileSIMD()
+{
+    simd = SIMD::level();
+
+    if( simd == SIMD::None ) {
+        Log() << "SIMD kernel unavailable on this CPU; using poly.";
+        return false;
+    }
+
+    vper = SIMD::maxLanes * nC;
+
+    vcof.assign( ncof * vper, 0.0 );
+    vmsk.assign( vper, 0 );
+
+    for( int j = 0; j < vper; ++j ) {
+
+        int ic = j % nC;
+
+        if( ic >= nai )
+            continue;
+
+        for( int k = 0; k < ncof; ++k )
+            vcof[k*vper + j] = cof[k*nai + ic];
+
+        vmsk[j] = -1;
+    }
+
+// Verify
+
+    const int   blktpts = 4096;
+    vec_i16     A( blktpts * nC ),
+                B;
+
+    for( int v0 = SHRT_MIN; v0 <= SHRT_MAX; v0 += blktpts ) {
+
+        for( int it = 0; it < blktpts; ++it ) {
+
+            for( int ic = 0; ic < nC; ++ic )
+                A[it*nC + ic] = v0 + it;
+        }
+
+        B = A;
+        applyPoly( &A[0], blktpts );
+        applySIMD( &B[0], blktpts );
+
+        if( A != B ) {
+            Log() << QString("SIMD kernel (%1) differs from poly; using poly.")
+                        .arg( SIMD::levelName( simd ) );
+            return false;
+        }
+    }
+
+    Log() << QString("SIMD kernel: %1.").arg( SIMD::levelName( simd ) );
+
+    return true;
+}
+
+
+// Convert each channel's polynomial, premultiplied by V2I, to
+// integer Horner form. Stage k keeps F[k] fractional bits, chosen
+// from the largest magnitude that stage reaches over all inputs so
+// that |H * v| < 2^61 and |H| < 2^47. F[] never increases toward
+// stage 0 (only right shifts), and F[0] <= 62.
+//
+// Proof by enumeration: every channel must reproduce poly1() for
+// all 65536 inputs, including clamping. Otherwise return false.
+//
+bool Plan::compileFixed()
+{
+    const int   HDRM = 46;  // stage magnitude < 2^HDRM
+
+    fcof.assign( ncof * nai, 0 );
+    fshf.assign( ncof * nai, 0 );
+
+    std::vector<double> a( ncof ),
+                        B( ncof );
+    std::vector<int>    F( ncof );
+
+    for( int ic = 0; ic < nai; ++ic ) {
+
+        // Stage bounds
+
+        for( int k = 0; k < ncof; ++k ) {
+            a[k] = V2I * cof[k*nai + ic];
+            B[k] = fabs( a[k] );
+        }
+
+        for( int v = SHRT_MIN; v <= SHRT_MAX; ++v ) {
+
+            double  h = a[ncof-1];
+
+            for( int k = ncof - 2; k >= 0; --k ) {
+                double  hv = h * v;
+                h = hv + a[k];
+                B[k] = qMax( B[k], qMax( fabs( hv ), fabs( h ) ) );
+            }
+        }
+
+        // Binary points
+
+        for( int k = 0; k < ncof; ++k ) {
+
+            int e = 0;
+
+            if( B[k] > 0 ) {
+                frexp( B[k], &e );
+                F[k] = HDRM - e;
+            }
+            else
+                F[k] = 1000;
+        }
+
+        for( int k = ncof - 2; k >= 0; --k )
+            F[k] = qMin( F[k], F[k+1] );
+
+        F[0] = qMin( F[0], 62 );
+
+        if( F[0] < 0 ) {
+            Log() << QString("Fixed kernel: chan %1 out of range; using poly.")
+                        .arg( ic );
+            return false;
+        }
+
+        for( int k = 1; k < ncof; ++k )
+            F[k] = qMin( F[k], F[k-1] + 62 );
+
+        for( int k = 0; k < ncof; ++k ) {
+            fcof[k*nai + ic] = qint64(floor( ldexp( a[k], F[k] ) + 0.5 ));
+            fshf[k*nai + ic] = (k ? F[k] - F[k-1] : F[0]);
+        }
+
+        // Proof
+
+        for( int v = SHRT_MIN; v <= SHRT_MAX; ++v ) {
+
+            if( fixed1( &fcof[ic], &fshf[ic], nai, ncof, v ) !=
+                poly1( &cof[ic], nai, ncof, V2I, v ) ) {
+
+                Log() <<
+                QString("Fixed kernel: chan %1 differs from poly at %2;"
+                " using poly.")
+                .arg( ic ).arg( v );
+                return false;
+            }
+        }
+    }
+
+    Log() << QString("Fixed kernel: exact for all 65536 inputs x %1 chans.")
+                .arg( nai );
+
+    return true;
+}
+
+
+// For each channel, measure the worst-case output error, over
+// all 65536 inputs, of an integer line and of a 256-segment
+// piecewise-linear fit to the full polynomial. Assign the first
+// of {affine, pwl, poly} that is exact.
+//
+void Plan::compileAdapt()
+{
+    static const char   *name[] = {"affine", "pwl", "poly"};
+
+    std::vector<qint64> G;
+    int                 nf[3] = {0, 0, 0};
+
+    ic2form.assign( nai, fPoly );
+    ic2seg.assign( nai, 0 );
+    seg.clear();
+
+    for( int ic = 0; ic < nai; ++ic ) {
+
+        int errA = fitLines( G, ic, 16 ),
+            errL = 0;
+
+        if( !errA )
+            ic2form[ic] = fAffine;
+        else if( !(errL = fitLines( G, ic, 8 )) )
+            ic2form[ic] = fPWL;
+        else
+            G.clear();
+
+        ic2seg[ic] = seg.size();
+        seg.insert( seg.end(), G.begin(), G.end() );
+        ++nf[ic2form[ic]];
+
+        Log() <<
+        QString("Adaptive kernel: chan %1 (dev%2 ai%3) %4"
+        " {max err: affine %5, pwl %6}.")
+        .arg( ic )
+        .arg( ic2K1[ic] ? 1 : 2 )
+        .arg( ic2ai[ic] )
+        .arg( name[ic2form[ic]] )
+        .arg( errA )
+        .arg( errA ? QString::number( errL ) : QString("-") );
+    }
+
+    Log() <<
+    QString("Adaptive kernel: %1 affine, %2 pwl, %3 poly.")
+    .arg( nf[fAffine] ).arg( nf[fPWL] ).arg( nf[fPoly] );
+}
+
+
+// Fit chords of V2I*poly to segments of 2^shift inputs.
+// Return worst |line1() - poly1()| over all inputs.
+//
+int Plan::fitLines( std::vector<qint64> &G, int ic, int shift ) const
+{
+    int w       = 1 << shift,
+        nseg    = 0x10000 >> shift,
+        err     = 0;
+
+    G.resize( 2 * nseg );
+
+    for( int is = 0; is < nseg; ++is ) {
+
+        int     v0 = SHRT_MIN + is * w;
+        double  y0 = polyReal( &cof[ic], nai, ncof, V2I, v0 ),
+                y1 = polyReal( &cof[ic], nai, ncof, V2I, v0 + w );
+
+        // Keeps Y0 + dY*du of line1() within qint64; NaN fails too
+
+        if( !(fabs( y0 ) <= LINEYMAX && fabs( y1 ) <= LINEYMAX) )
+            return 0x10000;
+
+        G[2*is]     = qint64(floor( ldexp( y0, 32 ) + 0.5 ));
+        G[2*is + 1] = qint64(floor( ldexp( (y1 - y0) / w, 32 ) + 0.5 ));
+    }
+
+    for( int v = SHRT_MIN; v <= SHRT_MAX; ++v ) {
+
+        err = qMax( err,
+                abs( line1( &G[0], shift, v )
+                    - poly1( &cof[ic], nai, ncof, V2I, v ) ) );
+    }
+
+    return err;
+}
+
+
+void Plan::applyPoly( qint16 *d, qint64 ntpts ) const
+{
+    const double    *C = &cof[0];
+
+    for( qint64 it = 0; it < ntpts; ++it, d += nC ) {
+
+        for( int ic = 0; ic < nai; ++ic )
+            d[ic] = poly1( &C[ic], nai, ncof, V2I, d[ic] );
+    }
+}
+
+
+void Plan::applyLUT( qint16 *d, qint64 ntpts ) const
+{
+    const qint16    *T = &lut[0];
+    const uint      *O = &ic2lut[0];
+
+    for( qint64 it = 0; it < ntpts; ++it, d += nC ) {
+
+        for( int ic = 0; ic < nai; ++ic )
+            d[ic] = T[O[ic] + quint16(d[ic])];
+    }
+}
+
+
+void Plan::applyFixed( qint16 *d, qint64 ntpts ) const
+{
+    const qint64    *A = &fcof[0];
+    const qint32    *S = &fshf[0];
+
+    for( qint64 it = 0; it < ntpts; ++it, d += nC ) {
+
+        for( int ic = 0; ic < nai; ++ic )
+            d[ic] = fixed1( &A[ic], &S[ic], nai, ncof, d[ic] );
+    }
+}
+
+
+void Plan::applyAdapt( qint16 *d, qint64 ntpts ) const
+{
+    const double    *C = &cof[0];
+    const qint64    *G = (seg.empty() ? 0 : &seg[0]);
+    const uint      *O = &ic2seg[0];
+    const uchar     *F = &ic2form[0];
+
+    for( qint64 it = 0; it < ntpts; ++it, d += nC ) {
+
+        for( int ic = 0; ic < nai; ++ic ) {
+
+            switch( F[ic] ) {
+                case fAffine:
+                    d[ic] = line1( &G[O[ic]], 16, d[ic] );
+                    break;
+                case fPWL:
+                    d[ic] = line1( &G[O[ic]], 8, d[ic] );
+                    break;
+                default:
+                    d[ic] = poly1( &C[ic], nai, ncof, V2I, d[ic] );
+                    break;
+            }
+        }
+    }
+}
+
+
+void Plan::applySIMD( qint16 *d, qint64 ntpts ) const
+{
+    const double    *C  = &vcof[0];
+    const qint16    *M  = &vmsk[0];
+    qint64          nw  = ntpts * nC,
+                    iw;
+
+    switch( simd ) {
+        case SIMD::AVX512:
+            iw = SIMD::scaleAVX512( d, nw, C, M, ncof, vper, V2I );
+            break;
+        case SIMD::AVX2:
+            iw = SIMD::scaleAVX2( d, nw, C, M, ncof, vper, V2I );
+            break;
+        default:
+            iw = SIMD::scaleSSE41( d, nw, C, M, ncof, vper, V2I );
+            break;
+    }
+
+// Remainder
+
+    for( ; iw < nw; ++iw ) {
+
+        int j = iw % vper;
+
+        if( M[j] )
+            d[iw] = poly1( &C[j], vper, ncof, V2I, d[iw] );
+    }
+}
+
+
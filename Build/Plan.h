@@ -0,0 +1,92 @@
+#ifndef PLAN_H
+#define PLAN_H
+
+#include "KVParams.h"
+#include "SGLTypes.h"
+
+#include <QSettings>
+
+#include <vector>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+struct Coeff {
+// Table of cal coeffs for given dev_product_voltage...
+// Addressed by physical NI channel.
+    int ncof;
+    std::vector<std::vector<double> >   V;
+    Coeff() : ncof(0)   {}
+    void get( QSettings &S, const QString &grpdev );
+};
+
+struct Plan {
+    enum Kernel {
+        kPoly,  // scalar Horner (reference)
+        kLUT,   // table lookup
+        kSIMD,  // vector Horner
+        kFixed, // integer Horner
+        kAdapt  // cheapest exact form per channel
+    };
+    enum Form {
+        fAffine,    // integer line
+        fPWL,       // integer piecewise-linear
+        fPoly       // full polynomial
+    };
+    typedef void (*PolyFn)( const Plan &P, qint16 *d, qint64 ntpts );
+// At each timepoint...
+// Which {Coeff table, physical channel} to apply
+    double                  V2I;    // volts -> i16
+    int                     nC,     // words/timepoint
+                            nai,    // vector size
+                            ncof;   // coeffs/channel (max)
+    std::vector<bool>       ic2K1;  // true if K1
+    std::vector<uint>       ic2ai;  // physical channel
+// Coeffs flattened in saved-channel order, zero-padded to ncof...
+// cof[k*nai + ic] = coeff k of saved channel ic
+    AlignedArray<double>    cof;
+// Compiled form (optional)...
+    Kernel                  kernel;
+// kPoly: Horner specialized on {ncof, nai, nC}, else 0 (generic)
+    PolyFn                  polyFn;
+// kLUT: One 64K-entry i16 -> i16 table per {Coeff table, ai}
+    std::vector<qint16>     lut;    // concatenated tables
+    std::vector<uint>       ic2lut; // offset of channel's table in lut
+// kSIMD: cof replicated per word over (vper) words
+    AlignedArray<double>    vcof;   // [ncof][vper]
+    AlignedArray<qint16>    vmsk;   // [vper] -1 if scaled
+    int                     vper,
+                            simd;   // SIMD::Level
+// kFixed: V2I*cof in int64 with per-stage binary point F[k]
+    AlignedArray<qint64>    fcof;   // [ncof][nai] V2I*cof * 2^F[k]
+    AlignedArray<qint32>    fshf;   // [ncof][nai] k ? F[k]-F[k-1] : F[0]
+// kAdapt: Form per channel; line segments {Y0, dY/dv} * 2^32
+    std::vector<uchar>      ic2form;
+    std::vector<uint>       ic2seg; // offset of channel's segs in seg
+    std::vector<qint64>     seg;
+    Plan()
+    :   nC(0), nai(0), ncof(0), kernel(kPoly), polyFn(0),
+        vper(0), simd(0)                                    {}
+    static int name2Kernel( const QString &name );
+    void make( const KVParams &kvp, const Coeff &K1, const Coeff &K2 );
+    void compile( Kernel k );
+    void apply( qint16 *d, qint64 ntpts ) const;
+    void apply( qint16 *dst, const qint16 *src, qint64 ntpts ) const;
+private:
+    void compilePoly();
+    void compileLUT();
+    bool compileSIMD();
+    bool compileFixed();
+    void compileAdapt();
+    int fitLines( std::vector<qint64> &G, int ic, int shift ) const;
+    void applyPoly( qint16 *d, qint64 ntpts ) const;
+    void applyLUT( qint16 *d, qint64 ntpts ) const;
+    void applySIMD( qint16 *d, qint64 ntpts ) const;
+    void applyFixed( qint16 *d, qint64 ntpts ) const;
+    void applyAdapt( qint16 *d, qint64 ntpts ) const;
+};
+
+#endif  // PLAN_H
+
+
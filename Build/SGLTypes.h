@@ -5,6 +5,8 @@
 #include <limits>
 #include <vector>
 
+#include <string.h>
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -19,6 +21,47 @@
 typedef std::vector<qint16> vec_i16;
 
 
+// Fixed-size array aligned for vector loads.
+//
+template<class T, int ALIGN = 64>
+class AlignedArray {
+private:
+    T       *p;
+    size_t  n;
+public:
+    AlignedArray() : p(0), n(0)                 {}
+    AlignedArray( const AlignedArray &rhs ) : p(0), n(0)
+        {*this = rhs;}
+    ~AlignedArray()                             {qFreeAligned( p );}
+    AlignedArray &operator=( const AlignedArray &rhs )
+        {
+            if( this != &rhs ) {
+                assign( rhs.n, T() );
+                if( n )
+                    memcpy( p, rhs.p, n*sizeof(T) );
+            }
+            return *this;
+        }
+    void assign( size_t count, const T &val )
+        {
+            if( count != n ) {
+                qFreeAligned( p );
+                p = (count ? (T*)qMallocAligned( count*sizeof(T), ALIGN ) : 0);
+                n = count;
+            }
+            for( size_t i = 0; i < n; ++i )
+                p[i] = val;
+        }
+    void clear()                                {assign( 0, T() );}
+    size_t size() const                         {return n;}
+    bool empty() const                          {return !n;}
+    T *data()                                   {return p;}
+    const T *data() const                       {return p;}
+    T &operator[]( size_t i )                   {return p[i];}
+    const T &operator[]( size_t i ) const       {return p[i];}
+};
+
+
 struct VRange {
     double  rmin,
             rmax;
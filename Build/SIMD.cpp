@@ -0,0 +1,821 @@
+
+
+#include "SIMD.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+#include <string.h>
+
+
+/* ---------------------------------------------------------------- */
+/* namespace SIMD ------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+namespace SIMD {
+
+/* ---------------------------------------------------------------- */
+/* level ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+int level()
+{
+    static int  L = -1;
+
+    if( L < 0 ) {
+
+        L = None;
+
+#ifdef SIMD_X86
+        __builtin_cpu_init();
+
+        if( __builtin_cpu_supports( "avx512f" )
+            && __builtin_cpu_supports( "avx512bw" ) ) {
+
+            L = AVX512;
+        }
+        else if( __builtin_cpu_supports( "avx2" ) )
+            L = AVX2;
+        else if( __builtin_cpu_supports( "sse4.1" ) )
+            L = SSE41;
+#endif
+    }
+
+    return L;
+}
+
+
+const char *levelName( int level )
+{
+    switch( level ) {
+        case SSE41:     return "SSE4.1";
+        case AVX2:      return "AVX2";
+        case AVX512:    return "AVX-512";
+        default:        return "none";
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* scaleSSE41 ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// 8 words per iteration: 4 x 2 doubles.
+//
+#ifdef SIMD_X86
+__attribute__((target("sse4.1")))
+qint64 scaleSSE41(
+    qint16          *d,
+    qint64          nw,
+    const double    *cof,
+    const qint16    *msk,
+    int             ncof,
+    int             period,
+    double          V2I )
+{
+    const __m128d   vV2I    = _mm_set1_pd( V2I );
+    qint64          nv      = nw & ~qint64(7);
+    int             o       = 0;
+
+    for( qint64 i = 0; i < nv; i += 8 ) {
+
+        __m128i raw = _mm_loadu_si128( (const __m128i*)&d[i] ),
+                lo  = _mm_cvtepi16_epi32( raw ),
+                hi  = _mm_cvtepi16_epi32( _mm_srli_si128( raw, 8 ) );
+        __m128d x[4],
+                V[4];
+
+        x[0] = _mm_cvtepi32_pd( lo );
+        x[1] = _mm_cvtepi32_pd( _mm_srli_si128( lo, 8 ) );
+        x[2] = _mm_cvtepi32_pd( hi );
+        x[3] = _mm_cvtepi32_pd( _mm_srli_si128( hi, 8 ) );
+
+        for( int j = 0; j < 4; ++j )
+            V[j] = _mm_setzero_pd();
+
+        for( int k = ncof - 1; k > 0; --k ) {
+
+            const double    *C = &cof[k*period + o];
+
+            for( int j = 0; j < 4; ++j ) {
+                V[j] = _mm_add_pd( V[j], _mm_loadu_pd( &C[2*j] ) );
+                V[j] = _mm_mul_pd( V[j], x[j] );
+            }
+        }
+
+        for( int j = 0; j < 4; ++j ) {
+            V[j] = _mm_add_pd( V[j], _mm_loadu_pd( &cof[o + 2*j] ) );
+            V[j] = _mm_mul_pd( vV2I, V[j] );
+        }
+
+        __m128i ilo = _mm_unpacklo_epi64(
+                        _mm_cvttpd_epi32( V[0] ),
+                        _mm_cvttpd_epi32( V[1] ) ),
+                ihi = _mm_unpacklo_epi64(
+                        _mm_cvttpd_epi32( V[2] ),
+                        _mm_cvttpd_epi32( V[3] ) ),
+                res = _mm_packs_epi32( ilo, ihi );
+
+        res = _mm_blendv_epi8(
+                raw, res, _mm_loadu_si128( (const __m128i*)&msk[o] ) );
+
+        _mm_storeu_si128( (__m128i*)&d[i], res );
+
+        if( (o += 8) >= period )
+            o = 0;
+    }
+
+    return nv;
+}
+#else
+qint64 scaleSSE41(
+    qint16          *,
+    qint64          ,
+    const double    *,
+    const qint16    *,
+    int             ,
+    int             ,
+    double          )
+{
+    return 0;
+}
+#endif
+
+/* ---------------------------------------------------------------- */
+/* scaleAVX2 ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// 8 words per iteration: 2 x 4 doubles.
+//
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+qint64 scaleAVX2(
+    qint16          *d,
+    qint64          nw,
+    const double    *cof,
+    const qint16    *msk,
+    int             ncof,
+    int             period,
+    double          V2I )
+{
+    const __m256d   vV2I    = _mm256_set1_pd( V2I );
+    qint64          nv      = nw & ~qint64(7);
+    int             o       = 0;
+
+    for( qint64 i = 0; i < nv; i += 8 ) {
+
+        __m128i raw = _mm_loadu_si128( (const __m128i*)&d[i] );
+        __m256d x0  = _mm256_cvtepi32_pd( _mm_cvtepi16_epi32( raw ) ),
+                x1  = _mm256_cvtepi32_pd(
+                        _mm_cvtepi16_epi32( _mm_srli_si128( raw, 8 ) ) ),
+                V0  = _mm256_setzero_pd(),
+                V1  = _mm256_setzero_pd();
+
+        for( int k = ncof - 1; k > 0; --k ) {
+
+            const double    *C = &cof[k*period + o];
+
+            V0 = _mm256_mul_pd( _mm256_add_pd( V0, _mm256_loadu_pd( C ) ), x0 );
+            V1 = _mm256_mul_pd( _mm256_add_pd( V1, _mm256_loadu_pd( C + 4 ) ), x1 );
+        }
+
+        V0 = _mm256_mul_pd( vV2I,
+                _mm256_add_pd( V0, _mm256_loadu_pd( &cof[o] ) ) );
+        V1 = _mm256_mul_pd( vV2I,
+                _mm256_add_pd( V1, _mm256_loadu_pd( &cof[o + 4] ) ) );
+
+        __m128i res = _mm_packs_epi32(
+                        _mm256_cvttpd_epi32( V0 ),
+                        _mm256_cvttpd_epi32( V1 ) );
+
+        res = _mm_blendv_epi8(
+                raw, res, _mm_loadu_si128( (const __m128i*)&msk[o] ) );
+
+        _mm_storeu_si128( (__m128i*)&d[i], res );
+
+        if( (o += 8) >= period )
+            o = 0;
+    }
+
+    return nv;
+}
+#else
+qint64 scaleAVX2(
+    qint16          *,
+    qint64          ,
+    const double    *,
+    const qint16    *,
+    int             ,
+    int             ,
+    double          )
+{
+    return 0;
+}
+#endif
+
+/* ---------------------------------------------------------------- */
+/* scaleAVX512 ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// 16 words per iteration: 2 x 8 doubles.
+//
+#ifdef SIMD_X86
+__attribute__((target("avx512f,avx512bw")))
+qint64 scaleAVX512(
+    qint16          *d,
+    qint64          nw,
+    const double    *cof,
+    const qint16    *msk,
+    int             ncof,
+    int             period,
+    double          V2I )
+{
+    const __m512d   vV2I    = _mm512_set1_pd( V2I );
+    qint64          nv      = nw & ~qint64(15);
+    int             o       = 0;
+
+    for( qint64 i = 0; i < nv; i += 16 ) {
+
+        __m256i raw = _mm256_loadu_si256( (const __m256i*)&d[i] );
+        __m512d x0  = _mm512_cvtepi32_pd(
+                        _mm256_cvtepi16_epi32(
+                        _mm256_castsi256_si128( raw ) ) ),
+                x1  = _mm512_cvtepi32_pd(
+                        _mm256_cvtepi16_epi32(
+                        _mm256_extracti128_si256( raw, 1 ) ) ),
+                V0  = _mm512_setzero_pd(),
+                V1  = _mm512_setzero_pd();
+
+        for( int k = ncof - 1; k > 0; --k ) {
+
+            const double    *C = &cof[k*period + o];
+
+            V0 = _mm512_mul_pd( _mm512_add_pd( V0, _mm512_loadu_pd( C ) ), x0 );
+            V1 = _mm512_mul_pd( _mm512_add_pd( V1, _mm512_loadu_pd( C + 8 ) ), x1 );
+        }
+
+        V0 = _mm512_mul_pd( vV2I,
+                _mm512_add_pd( V0, _mm512_loadu_pd( &cof[o] ) ) );
+        V1 = _mm512_mul_pd( vV2I,
+                _mm512_add_pd( V1, _mm512_loadu_pd( &cof[o + 8] ) ) );
+
+        // packs works within 128-bit halves; restore word order
+
+        __m256i res = _mm256_permute4x64_epi64(
+                        _mm256_packs_epi32(
+                            _mm512_cvttpd_epi32( V0 ),
+                            _mm512_cvttpd_epi32( V1 ) ),
+                        0xD8 );
+
+        res = _mm256_blendv_epi8(
+                raw, res, _mm256_loadu_si256( (const __m256i*)&msk[o] ) );
+
+        _mm256_storeu_si256( (__m256i*)&d[i], res );
+
+        if( (o += 16) >= period )
+            o = 0;
+    }
+
+    return nv;
+}
+#else
+qint64 scaleAVX512(
+    qint16          *,
+    qint64          ,
+    const double    *,
+    const qint16    *,
+    int             ,
+    int             ,
+    double          )
+{
+    return 0;
+}
+#endif
+
+/* ---------------------------------------------------------------- */
+/* gatherSSSE3 ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// (tpv) timepoints per iteration: load, shuffle, store.
+//
+#ifdef SIMD_X86
+__attribute__((target("ssse3")))
+qint64 gatherSSSE3(
+    qint16          *dst,
+    const qint16    *src,
+    qint64          ntpts,
+    int             nchans,
+    int             nkeep,
+    int             tpv,
+    const char      *shuf )
+{
+    const __m128i   S   = _mm_loadu_si128( (const __m128i*)shuf );
+    qint64          nw  = ntpts * nchans,
+                    nwo = ntpts * nkeep,
+                    it  = 0;
+
+    for( ; it*nchans + 8 <= nw && it*nkeep + 8 <= nwo; it += tpv ) {
+
+        __m128i v = _mm_loadu_si128( (const __m128i*)&src[it*nchans] );
+
+        _mm_storeu_si128( (__m128i*)&dst[it*nkeep], _mm_shuffle_epi8( v, S ) );
+    }
+
+    return it;
+}
+#else
+qint64 gatherSSSE3(
+    qint16          *,
+    const qint16    *,
+    qint64          ,
+    int             ,
+    int             ,
+    int             ,
+    const char      * )
+{
+    return 0;
+}
+#endif
+
+/* ---------------------------------------------------------------- */
+/* gatherAVX2 ----------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// 2 x (tpv) timepoints per iteration: vpshufb shuffles each 128-bit
+// lane on its own, so each lane takes a group of (tpv). The high
+// lane's store lands right after the low lane's kept words,
+// overwriting the low lane's unused tail.
+//
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+qint64 gatherAVX2(
+    qint16          *dst,
+    const qint16    *src,
+    qint64          ntpts,
+    int             nchans,
+    int             nkeep,
+    int             tpv,
+    const char      *shuf )
+{
+    const __m256i   S   = _mm256_broadcastsi128_si256(
+                            _mm_loadu_si128( (const __m128i*)shuf ) );
+    qint64          nw  = ntpts * nchans,
+                    nwo = ntpts * nkeep,
+                    it  = 0;
+    int             gi  = tpv * nchans,
+                    go  = tpv * nkeep;
+
+    for( ; it*nchans + gi + 8 <= nw && it*nkeep + go + 8 <= nwo; it += 2*tpv ) {
+
+        const qint16    *s = &src[it*nchans];
+        qint16          *d = &dst[it*nkeep];
+        __m256i         v = _mm256_inserti128_si256(
+                                _mm256_castsi128_si256(
+                                    _mm_loadu_si128( (const __m128i*)s ) ),
+                                _mm_loadu_si128( (const __m128i*)(s + gi) ),
+                                1 );
+
+        v = _mm256_shuffle_epi8( v, S );
+
+        _mm_storeu_si128( (__m128i*)d, _mm256_castsi256_si128( v ) );
+        _mm_storeu_si128( (__m128i*)(d + go), _mm256_extracti128_si256( v, 1 ) );
+    }
+
+    return it;
+}
+#else
+qint64 gatherAVX2(
+    qint16          *,
+    const qint16    *,
+    qint64          ,
+    int             ,
+    int             ,
+    int             ,
+    const char      * )
+{
+    return 0;
+}
+#endif
+
+/* ---------------------------------------------------------------- */
+/* binMeanSSE41 --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// 8 channels per step: 2 x 4 int32 sums, 4 x 2 double quotients.
+//
+#ifdef SIMD_X86
+__attribute__((target("sse4.1")))
+int binMeanSSE41(
+    qint16          *dst,
+    const qint16    *src,
+    int             nchans,
+    int             nrows,
+    qint32          *acc )
+{
+    int nv = nchans & ~7;
+
+    for( int ic = 0; ic < nv; ic += 8 ) {
+
+        __m128i raw = _mm_loadu_si128( (const __m128i*)&src[ic] );
+
+        _mm_storeu_si128( (__m128i*)&acc[ic], _mm_cvtepi16_epi32( raw ) );
+        _mm_storeu_si128( (__m128i*)&acc[ic + 4],
+            _mm_cvtepi16_epi32( _mm_srli_si128( raw, 8 ) ) );
+    }
+
+    for( int ir = 1; ir < nrows; ++ir ) {
+
+        const qint16    *S = &src[qint64(ir) * nchans];
+
+        for( int ic = 0; ic < nv; ic += 8 ) {
+
+            __m128i raw = _mm_loadu_si128( (const __m128i*)&S[ic] ),
+                    a0  = _mm_loadu_si128( (const __m128i*)&acc[ic] ),
+                    a1  = _mm_loadu_si128( (const __m128i*)&acc[ic + 4] );
+
+            a0 = _mm_add_epi32( a0, _mm_cvtepi16_epi32( raw ) );
+            a1 = _mm_add_epi32( a1,
+                    _mm_cvtepi16_epi32( _mm_srli_si128( raw, 8 ) ) );
+
+            _mm_storeu_si128( (__m128i*)&acc[ic], a0 );
+            _mm_storeu_si128( (__m128i*)&acc[ic + 4], a1 );
+        }
+    }
+
+    const __m128d   vn = _mm_set1_pd( nrows );
+
+    for( int ic = 0; ic < nv; ic += 8 ) {
+
+        __m128i a0  = _mm_loadu_si128( (const __m128i*)&acc[ic] ),
+                a1  = _mm_loadu_si128( (const __m128i*)&acc[ic + 4] ),
+                q0  = _mm_unpacklo_epi64(
+                        _mm_cvttpd_epi32(
+                            _mm_div_pd( _mm_cvtepi32_pd( a0 ), vn ) ),
+                        _mm_cvttpd_epi32(
+                            _mm_div_pd( _mm_cvtepi32_pd(
+                                _mm_srli_si128( a0, 8 ) ), vn ) ) ),
+                q1  = _mm_unpacklo_epi64(
+                        _mm_cvttpd_epi32(
+                            _mm_div_pd( _mm_cvtepi32_pd( a1 ), vn ) ),
+                        _mm_cvttpd_epi32(
+                            _mm_div_pd( _mm_cvtepi32_pd(
+                                _mm_srli_si128( a1, 8 ) ), vn ) ) );
+
+        _mm_storeu_si128( (__m128i*)&dst[ic], _mm_packs_epi32( q0, q1 ) );
+    }
+
+    return nv;
+}
+#else
+int binMeanSSE41(
+    qint16          *,
+    const qint16    *,
+    int             ,
+    int             ,
+    qint32          * )
+{
+    return 0;
+}
+#endif
+
+/* ---------------------------------------------------------------- */
+/* binMeanAVX2 ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// 8 channels per step: 8 int32 sums, 2 x 4 double quotients.
+//
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+int binMeanAVX2(
+    qint16          *dst,
+    const qint16    *src,
+    int             nchans,
+    int             nrows,
+    qint32          *acc )
+{
+    int nv = nchans & ~7;
+
+    for( int ic = 0; ic < nv; ic += 8 ) {
+
+        _mm256_storeu_si256( (__m256i*)&acc[ic],
+            _mm256_cvtepi16_epi32(
+                _mm_loadu_si128( (const __m128i*)&src[ic] ) ) );
+    }
+
+    for( int ir = 1; ir < nrows; ++ir ) {
+
+        const qint16    *S = &src[qint64(ir) * nchans];
+
+        for( int ic = 0; ic < nv; ic += 8 ) {
+
+            __m256i a = _mm256_loadu_si256( (const __m256i*)&acc[ic] );
+
+            a = _mm256_add_epi32( a,
+                    _mm256_cvtepi16_epi32(
+                        _mm_loadu_si128( (const __m128i*)&S[ic] ) ) );
+
+            _mm256_storeu_si256( (__m256i*)&acc[ic], a );
+        }
+    }
+
+    const __m256d   vn = _mm256_set1_pd( nrows );
+
+    for( int ic = 0; ic < nv; ic += 8 ) {
+
+        __m256i a   = _mm256_loadu_si256( (const __m256i*)&acc[ic] );
+        __m128i q0  = _mm256_cvttpd_epi32(
+                        _mm256_div_pd(
+                            _mm256_cvtepi32_pd( _mm256_castsi256_si128( a ) ),
+                            vn ) ),
+                q1  = _mm256_cvttpd_epi32(
+                        _mm256_div_pd(
+                            _mm256_cvtepi32_pd( _mm256_extracti128_si256( a, 1 ) ),
+                            vn ) );
+
+        _mm_storeu_si128( (__m128i*)&dst[ic], _mm_packs_epi32( q0, q1 ) );
+    }
+
+    return nv;
+}
+#else
+int binMeanAVX2(
+    qint16          *,
+    const qint16    *,
+    int             ,
+    int             ,
+    qint32          * )
+{
+    return 0;
+}
+#endif
+
+/* ---------------------------------------------------------------- */
+/* binPeakSSE41 --------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// |x| as unsigned 16-bit: abs_epi16(-32768) is 0x8000, which
+// compares as 32768 unsigned, so max_epu16 picks larger |x|.
+//
+#ifdef SIMD_X86
+__attribute__((target("sse4.1")))
+static inline __m128i peakSel128( __m128i mn, __m128i mx )
+{
+    __m128i amn = _mm_abs_epi16( mn ),
+            amx = _mm_abs_epi16( mx ),
+            sel = _mm_cmpeq_epi16( _mm_max_epu16( amx, amn ), amx );
+
+    return _mm_blendv_epi8( mn, mx, sel );
+}
+
+
+// 8 channels per step.
+//
+__attribute__((target("sse4.1")))
+int binPeakSSE41(
+    qint16          *dst,
+    const qint16    *src,
+    int             nchans,
+    int             nrows,
+    qint16          *lo,
+    qint16          *hi )
+{
+    int nv = nchans & ~7;
+
+    memcpy( lo, src, nv * sizeof(qint16) );
+    memcpy( hi, src, nv * sizeof(qint16) );
+
+    for( int ir = 1; ir < nrows; ++ir ) {
+
+        const qint16    *S = &src[qint64(ir) * nchans];
+
+        for( int ic = 0; ic < nv; ic += 8 ) {
+
+            __m128i v = _mm_loadu_si128( (const __m128i*)&S[ic] );
+
+            _mm_storeu_si128( (__m128i*)&lo[ic],
+                _mm_min_epi16( _mm_loadu_si128( (const __m128i*)&lo[ic] ), v ) );
+            _mm_storeu_si128( (__m128i*)&hi[ic],
+                _mm_max_epi16( _mm_loadu_si128( (const __m128i*)&hi[ic] ), v ) );
+        }
+    }
+
+    for( int ic = 0; ic < nv; ic += 8 ) {
+
+        _mm_storeu_si128( (__m128i*)&dst[ic],
+            peakSel128(
+                _mm_loadu_si128( (const __m128i*)&lo[ic] ),
+                _mm_loadu_si128( (const __m128i*)&hi[ic] ) ) );
+    }
+
+    return nv;
+}
+#else
+int binPeakSSE41(
+    qint16          *,
+    const qint16    *,
+    int             ,
+    int             ,
+    qint16          *,
+    qint16          * )
+{
+    return 0;
+}
+#endif
+
+/* ---------------------------------------------------------------- */
+/* binPeakAVX2 ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// 16 channels per step, then 8 if that many remain.
+//
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+int binPeakAVX2(
+    qint16          *dst,
+    const qint16    *src,
+    int             nchans,
+    int             nrows,
+    qint16          *lo,
+    qint16          *hi )
+{
+    int nv  = nchans & ~7,
+        n16 = nchans & ~15;
+
+    memcpy( lo, src, nv * sizeof(qint16) );
+    memcpy( hi, src, nv * sizeof(qint16) );
+
+    for( int ir = 1; ir < nrows; ++ir ) {
+
+        const qint16    *S = &src[qint64(ir) * nchans];
+
+        for( int ic = 0; ic < n16; ic += 16 ) {
+
+            __m256i v = _mm256_loadu_si256( (const __m256i*)&S[ic] );
+
+            _mm256_storeu_si256( (__m256i*)&lo[ic],
+                _mm256_min_epi16(
+                    _mm256_loadu_si256( (const __m256i*)&lo[ic] ), v ) );
+            _mm256_storeu_si256( (__m256i*)&hi[ic],
+                _mm256_max_epi16(
+                    _mm256_loadu_si256( (const __m256i*)&hi[ic] ), v ) );
+        }
+
+        if( nv > n16 ) {
+
+            __m128i v = _mm_loadu_si128( (const __m128i*)&S[n16] );
+
+            _mm_storeu_si128( (__m128i*)&lo[n16],
+                _mm_min_epi16( _mm_loadu_si128( (const __m128i*)&lo[n16] ), v ) );
+            _mm_storeu_si128( (__m128i*)&hi[n16],
+                _mm_max_epi16( _mm_loadu_si128( (const __m128i*)&hi[n16] ), v ) );
+        }
+    }
+
+    for( int ic = 0; ic < n16; ic += 16 ) {
+
+        __m256i mn  = _mm256_loadu_si256( (const __m256i*)&lo[ic] ),
+                mx  = _mm256_loadu_si256( (const __m256i*)&hi[ic] ),
+                amn = _mm256_abs_epi16( mn ),
+                amx = _mm256_abs_epi16( mx ),
+                sel = _mm256_cmpeq_epi16( _mm256_max_epu16( amx, amn ), amx );
+
+        _mm256_storeu_si256( (__m256i*)&dst[ic],
+            _mm256_blendv_epi8( mn, mx, sel ) );
+    }
+
+    if( nv > n16 ) {
+
+        _mm_storeu_si128( (__m128i*)&dst[n16],
+            peakSel128(
+                _mm_loadu_si128( (const __m128i*)&lo[n16] ),
+                _mm_loadu_si128( (const __m128i*)&hi[n16] ) ) );
+    }
+
+    return nv;
+}
+#else
+int binPeakAVX2(
+    qint16          *,
+    const qint16    *,
+    int             ,
+    int             ,
+    qint16          *,
+    qint16          * )
+{
+    return 0;
+}
+#endif
+
+/* ---------------------------------------------------------------- */
+/* crc32c --------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Slicing-by-8 tables for the reflected polynomial 0x82F63B78.
+//
+struct CrcTables
+{
+    quint32 T[8][256];
+
+    CrcTables()
+    {
+        for( int i = 0; i < 256; ++i ) {
+
+            quint32 c = i;
+
+            for( int k = 0; k < 8; ++k )
+                c = (c >> 1) ^ (0x82F63B78 & (0 - (c & 1)));
+
+            T[0][i] = c;
+        }
+
+        for( int i = 0; i < 256; ++i ) {
+
+            for( int j = 1; j < 8; ++j )
+                T[j][i] = (T[j-1][i] >> 8) ^ T[0][T[j-1][i] & 0xFF];
+        }
+    }
+};
+
+
+static quint32 crcTable( quint32 c, const uchar *p, qint64 n )
+{
+    static const CrcTables  X;      // built once, thread-safe
+    const quint32           *T = &X.T[0][0];
+
+    for( ; n >= 8; p += 8, n -= 8 ) {
+
+        quint32 lo = c ^ (p[0] | p[1] << 8 | p[2] << 16 | quint32(p[3]) << 24),
+                hi = p[4] | p[5] << 8 | p[6] << 16 | quint32(p[7]) << 24;
+
+        c = T[7*256 + (lo & 0xFF)]         ^ T[6*256 + ((lo >> 8) & 0xFF)]
+          ^ T[5*256 + ((lo >> 16) & 0xFF)] ^ T[4*256 + (lo >> 24)]
+          ^ T[3*256 + (hi & 0xFF)]         ^ T[2*256 + ((hi >> 8) & 0xFF)]
+          ^ T[1*256 + ((hi >> 16) & 0xFF)] ^ T[0*256 + (hi >> 24)];
+    }
+
+    while( n-- > 0 )
+        c = (c >> 8) ^ T[(c ^ *p++) & 0xFF];
+
+    return c;
+}
+
+
+#ifdef SIMD_X86
+__attribute__((target("sse4.2")))
+static quint32 crcSSE42( quint32 c, const uchar *p, qint64 n )
+{
+#ifdef __x86_64__
+    quint64 c64 = c;
+
+    for( ; n >= 8; p += 8, n -= 8 ) {
+
+        quint64 w;
+        memcpy( &w, p, 8 );
+        c64 = _mm_crc32_u64( c64, w );
+    }
+
+    c = quint32(c64);
+#else
+    for( ; n >= 4; p += 4, n -= 4 ) {
+
+        quint32 w;
+        memcpy( &w, p, 4 );
+        c = _mm_crc32_u32( c, w );
+    }
+#endif
+
+    while( n-- > 0 )
+        c = _mm_crc32_u8( c, *p++ );
+
+    return c;
+}
+#endif
+
+
+quint32 crc32c( quint32 crc, const void *data, qint64 bytes )
+{
+    const uchar *p = (const uchar*)data;
+
+#ifdef SIMD_X86
+    static int  sse42 = -1;
+
+    if( sse42 < 0 ) {
+        __builtin_cpu_init();
+        sse42 = __builtin_cpu_supports( "sse4.2" ) != 0;
+    }
+
+    if( sse42 )
+        return ~crcSSE42( ~crc, p, bytes );
+#endif
+
+    return ~crcTable( ~crc, p, bytes );
+}
+
+/* ---------------------------------------------------------------- */
+/* end namespace SIMD --------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+}   // namespace SIMD
+
+
@@ -0,0 +1,157 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <qglobal.h>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Vector kernels with runtime CPU dispatch.
+//
+// Scaling kernels treat a buffer of whole timepoints as one flat
+// stream of words. Word j of the stream uses the coefficients in
+// lane (j % period) of the cof[] and msk[] tables. The caller sets
+// period to a multiple of both nC and SIMD::maxLanes, so every run
+// of lanes reads contiguous table entries. Words with msk[] == 0
+// (digital or unscaled channels) pass through unchanged.
+//
+// Each kernel evaluates the same IEEE operation sequence as the
+// scalar Horner loop (no FMA), truncates toward zero and saturates
+// to int16 with packed instructions, so results are bit-identical.
+//
+// Kernels return the count of words processed, a multiple of their
+// lane width. The caller finishes any remaining words.
+//
+namespace SIMD
+{
+
+enum Level {
+    None    = 0,
+    SSE41   = 1,
+    AVX2    = 2,
+    AVX512  = 3
+};
+
+enum {
+    maxLanes = 16
+};
+
+// Widest level supported by this CPU (and OS)
+int level();
+
+const char *levelName( int level );
+
+qint64 scaleSSE41(
+    qint16          *d,
+    qint64          nw,
+    const double    *cof,
+    const qint16    *msk,
+    int             ncof,
+    int             period,
+    double          V2I );
+
+qint64 scaleAVX2(
+    qint16          *d,
+    qint64          nw,
+    const double    *cof,
+    const qint16    *msk,
+    int             ncof,
+    int             period,
+    double          V2I );
+
+qint64 scaleAVX512(
+    qint16          *d,
+    qint64          nw,
+    const double    *cof,
+    const qint16    *msk,
+    int             ncof,
+    int             period,
+    double          V2I );
+
+// Channel gather: (dst) gets, for each timepoint of (nchans) words
+// in (src), (nkeep) words picked by byte map (shuf). One 16-byte
+// vector holds (tpv) whole timepoints, and (shuf) packs the kept
+// words of all (tpv) to its front. Vectors are loaded and stored
+// whole, so (dst) must not overlap (src); no access passes the
+// ends of either buffer.
+//
+// Kernels return the count of timepoints done, a multiple of
+// (tpv). The caller finishes the remaining timepoints.
+//
+qint64 gatherSSSE3(
+    qint16          *dst,
+    const qint16    *src,
+    qint64          ntpts,
+    int             nchans,
+    int             nkeep,
+    int             tpv,
+    const char      *shuf );
+
+qint64 gatherAVX2(
+    qint16          *dst,
+    const qint16    *src,
+    qint64          ntpts,
+    int             nchans,
+    int             nkeep,
+    int             tpv,
+    const char      *shuf );
+
+// Bin mean for Subset::downsample(): for each channel, the sum
+// of (nrows) rows of (nchans) words at (src), in int32 (acc),
+// then dst[ic] = qint16(double(sum) / nrows), as the scalar code
+// does. (nrows) * 32768 must fit in int32. In-place use, (dst)
+// at or before (src), is allowed.
+//
+// Kernels return the count of channels done, a multiple of 8.
+// The caller finishes the remaining channels.
+//
+int binMeanSSE41(
+    qint16          *dst,
+    const qint16    *src,
+    int             nchans,
+    int             nrows,
+    qint32          *acc );
+
+int binMeanAVX2(
+    qint16          *dst,
+    const qint16    *src,
+    int             nchans,
+    int             nrows,
+    qint32          *acc );
+
+// Bin peak for Subset::downsampleNeural(): for each channel, the
+// min and max of (nrows) rows of (nchans) words at (src), kept in
+// (lo) and (hi), then dst[ic] = whichever has the larger absolute
+// value, max on ties. Branch-free packed min/max. In-place use,
+// (dst) at or before (src), is allowed.
+//
+// Kernels return the count of channels done, a multiple of 8.
+// The caller finishes the remaining channels.
+//
+int binPeakSSE41(
+    qint16          *dst,
+    const qint16    *src,
+    int             nchans,
+    int             nrows,
+    qint16          *lo,
+    qint16          *hi );
+
+int binPeakAVX2(
+    qint16          *dst,
+    const qint16    *src,
+    int             nchans,
+    int             nrows,
+    qint16          *lo,
+    qint16          *hi );
+
+// CRC32C (Castagnoli) of (bytes) at (data), continuing (crc),
+// 0 to start. Uses the SSE4.2 crc32 instruction if the CPU has
+// it, else tables; the result is the same.
+quint32 crc32c( quint32 crc, const void *data, qint64 bytes );
+
+}   // namespace SIMD
+
+#endif  // SIMD_H
+
+
@@ -0,0 +1,1691 @@
+
+
+#include "Scaler.h"
+#include "Cbin.h"
+#include "Crc.h"
+#include "Plan.h"
+#include "SGLTypes.h"
+#include "Subset.h"
+#include "Util.h"
+#include "Uring.h"
+
+#include <QCryptographicHash>
+#include <QThread>
+
+#include <vector>
+
+#include <errno.h>
+#include <string.h>
+
+
+#define BUFBYTES    (128*1024)
+#define CHUNKBYTES  (4*1024*1024)
+#define PIPEBYTES   (1024*1024)
+#define PIPEBUFS    4
+#define MAPBYTES    (64*1024*1024)
+#define URINGBYTES  (1024*1024)
+#define URINGDEPTH  16
+#define URINGRETRY  100
+#define URINGCANCEL (quint64(1) << 32)
+#define DIRECTALIGN 4096
+#define DIRECTTHREADS   4
+#define JOURNALBYTES    (16*1024*1024)
+#define SEGBYTES    (qint64(1024)*1024*1024)
+#define PUMPBYTES   (1024*1024)
+#define PUMPBUFS    8
+
+
+/* ---------------------------------------------------------------- */
+/* Statics -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Scale (nt) timepoints at (d) in place; with (gt), the kept
+// channels are then packed to the front of (d).
+//
+static void scaleKeep( const Plan &P, const Gather *gt, qint16 *d, qint64 nt )
+{
+    P.apply( d, nt );
+
+    if( gt )
+        gt->apply( d, d, nt );
+}
+
+/* ---------------------------------------------------------------- */
+/* OutDigest ------------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+// Scaled output, in file order, goes to whichever of the
+// whole-file (hash) and per-chunk (crc) digests are set.
+//
+struct OutDigest
+{
+    QCryptographicHash  *hash;
+    ChunkCrc            *crc;
+
+    OutDigest( QCryptographicHash *hash, ChunkCrc *crc )
+    :   hash(hash), crc(crc)    {}
+
+    bool on() const {return hash || crc;}
+
+    void add( const char *data, qint64 bytes ) const
+    {
+        if( hash )
+            hash->addData( data, bytes );
+
+        if( crc )
+            crc->add( data, bytes );
+    }
+};
+
+/* ---------------------------------------------------------------- */
+/* OrderedHash ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Feeds chunks that finish in any order to (out) in file order.
+// The worker holding chunk i waits until chunks < i are hashed;
+// chunks are claimed in order, so the wait is always short.
+//
+struct OrderedHash
+{
+    const OutDigest         &out;
+    QAtomicInteger<qint64>  nhashed;
+    QAtomicInt              &fail;
+
+    OrderedHash( const OutDigest &out, QAtomicInt &fail )
+    :   out(out), nhashed(0), fail(fail)    {}
+
+    bool add( qint64 ichk, const char *data, qint64 bytes );
+};
+
+
+// Return false if failed.
+//
+bool OrderedHash::add( qint64 ichk, const char *data, qint64 bytes )
+{
+    for( int spin = 0; nhashed.loadAcquire() < ichk; ++spin ) {
+
+        if( fail.load() )
+            return false;
+
+        if( spin < 64 )
+            QThread::yieldCurrentThread();
+        else
+            QThread::usleep( 100 );
+    }
+
+    out.add( data, bytes );
+    nhashed.storeRelease( ichk + 1 );
+
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* HashPump ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Hashes copies of data on its own thread, so the caller doesn't
+// wait on the hash. Callers pass a sequence number (iseq), 0, 1,
+// ..., and the data is hashed in that order, whichever thread
+// adds it. Data is copied in pieces into a ring of (PUMPBUFS)
+// buffers; add() waits only when the ring is full.
+//
+// With no (hash), add() does nothing. Destruction ends the pump.
+//
+class HashPump : public QThread
+{
+private:
+    QCryptographicHash              *hash;
+    QAtomicInt                      &fail;
+    std::vector<std::vector<char> > buf;
+    std::vector<qint64>             len;
+    QAtomicInteger<qint64>          nseq,       // calls done
+                                    nadded,     // pieces
+                                    nhashed;
+    QAtomicInt                      ended;
+
+public:
+    HashPump( QCryptographicHash *hash, QAtomicInt &fail );
+    virtual ~HashPump() {end();}
+
+    void begin()    {if( hash ) start();}
+    bool add( qint64 iseq, const char *data, qint64 bytes );
+    void end();
+
+protected:
+    virtual void run();
+
+private:
+    bool waitFor(
+        const QAtomicInteger<qint64>    &cursor,
+        qint64                          need,
+        bool                            quitOnEnd );
+};
+
+
+HashPump::HashPump( QCryptographicHash *hash, QAtomicInt &fail )
+    :   hash(hash), fail(fail), nseq(0), nadded(0), nhashed(0), ended(0)
+{
+    if( hash ) {
+        buf.assign( PUMPBUFS, std::vector<char>( PUMPBYTES ) );
+        len.assign( PUMPBUFS, 0 );
+    }
+}
+
+
+// Return false if failed.
+//
+bool HashPump::add( qint64 iseq, const char *data, qint64 bytes )
+{
+    if( !hash )
+        return true;
+
+    if( !waitFor( nseq, iseq, false ) )
+        return false;
+
+    for( qint64 done = 0; done < bytes; ) {
+
+        qint64  i = nadded.load();
+
+        if( !waitFor( nhashed, i - PUMPBUFS + 1, false ) )
+            return false;
+
+        qint64  islot   = i % PUMPBUFS,
+                n       = qMin( bytes - done, qint64(PUMPBYTES) );
+
+        memcpy( &buf[islot][0], data + done, n );
+        len[islot] = n;
+        nadded.storeRelease( i + 1 );
+        done += n;
+    }
+
+    nseq.storeRelease( iseq + 1 );
+
+    return true;
+}
+
+
+// Hash remaining pieces, then stop.
+//
+void HashPump::end()
+{
+    if( hash ) {
+        ended.storeRelease( 1 );
+        wait();
+    }
+}
+
+
+void HashPump::run()
+{
+    for( qint64 i = 0; waitFor( nadded, i + 1, true ); ++i ) {
+
+        qint64  islot = i % PUMPBUFS;
+
+        hash->addData( &buf[islot][0], len[islot] );
+        nhashed.storeRelease( i + 1 );
+    }
+}
+
+
+// Wait until (cursor) >= (need). Return false if failed,
+// or, if (quitOnEnd), once ended with nothing left.
+//
+bool HashPump::waitFor(
+    const QAtomicInteger<qint64>    &cursor,
+    qint64                          need,
+    bool                            quitOnEnd )
+{
+    for( int spin = 0; cursor.loadAcquire() < need; ++spin ) {
+
+        if( fail.load() )
+            return false;
+
+        if( quitOnEnd && ended.loadAcquire() && cursor.loadAcquire() < need )
+            return false;
+
+        if( spin < 64 )
+            QThread::yieldCurrentThread();
+        else
+            QThread::usleep( 100 );
+    }
+
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* ScaleThread ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Worker for Scaler::threaded().
+//
+// Repeatedly claims the next chunk of (chktpts) timepoints from
+// the (ntpts) starting at (tbase), then reads, scales and writes
+// it at the same timepoint; reads are (twin) timepoints later.
+// Written timepoints are (otpbytes), fewer if (gt) drops channels.
+// Chunks finish in any order, but every byte lands where the
+// serial engine would put it.
+//
+// Transfers are rounded up to a multiple of (align) bytes; the
+// caller makes chunk offsets aligned and trims the file after.
+//
+// If (ca) is set, fa is that .cbin, and chunks are decoded from it.
+// If (oh) is set, scaled chunks are hashed in order. Chunks read
+// go to (pump) before scaling.
+//
+class ScaleThread : public QThread
+{
+private:
+    const Plan      &P;
+    const Cbin      *ca;
+    const Gather    *gt;
+    OrderedHash     *oh;
+    HashPump        &pump;
+    QFile           &fa,
+                    &fb;
+    QAtomicInt      &next,
+                    &fail;
+    qint64          tpbytes,
+                    otpbytes,
+                    tbase,
+                    twin,
+                    ntpts,
+                    chktpts,
+                    align;
+
+public:
+    ScaleThread(
+        const Plan      &P,
+        const Cbin      *ca,
+        const Gather    *gt,
+        OrderedHash     *oh,
+        HashPump        &pump,
+        QFile           &fa,
+        QFile           &fb,
+        QAtomicInt      &next,
+        QAtomicInt      &fail,
+        qint64          tpbytes,
+        qint64          otpbytes,
+        qint64          tbase,
+        qint64          twin,
+        qint64          ntpts,
+        qint64          chktpts,
+        qint64          align )
+    :   P(P), ca(ca), gt(gt), oh(oh), pump(pump), fa(fa), fb(fb),
+        next(next), fail(fail),
+        tpbytes(tpbytes), otpbytes(otpbytes), tbase(tbase), twin(twin),
+        ntpts(ntpts), chktpts(chktpts), align(align)        {}
+
+protected:
+    virtual void run();
+};
+
+
+void ScaleThread::run()
+{
+    AlignedArray<char,DIRECTALIGN>  buf;
+    std::vector<char>               z;
+    std::vector<qint16>             tmp;
+    qint64                          nchk = (ntpts + chktpts - 1) / chktpts;
+
+    buf.assign( (chktpts * tpbytes + align - 1) / align * align, 0 );
+
+    while( !fail.load() ) {
+
+        qint64  ichk = next.fetchAndAddOrdered( 1 );
+
+        if( ichk >= nchk )
+            break;
+
+        qint64  t0      = ichk * chktpts,
+                nt      = qMin( chktpts, ntpts - t0 ),
+                bytes   = nt * tpbytes,
+                iobytes = (bytes + align - 1) / align * align,
+                offset  = (twin + tbase + t0) * tpbytes,
+                obytes  = nt * otpbytes,
+                oiobytes= (obytes + align - 1) / align * align;
+
+        if( ca ) {
+
+            if( !ca->read( fa, (qint16*)&buf[0], twin + tbase + t0, nt, z, tmp ) ) {
+                fail.store( 1 );
+                break;
+            }
+        }
+        else if( readAt( fa, &buf[0], iobytes, offset ) < bytes ) {
+            fail.store( 1 );
+            break;
+        }
+
+        if( !pump.add( ichk, &buf[0], bytes ) )
+            break;
+
+        scaleKeep( P, gt, (qint16*)&buf[0], nt );
+
+        if( writeAt( fb, &buf[0], oiobytes, (tbase + t0) * otpbytes )
+            != oiobytes ) {
+
+            fail.store( 1 );
+            break;
+        }
+
+        if( oh && !oh->add( ichk, &buf[0], obytes ) )
+            break;
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* PipeRing ------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Buffers handed reader -> scaler -> writer -> reader for
+// Scaler::pipelined().
+//
+// Buffer i of the stream lives in slot (i % nbuf). Each stage
+// owns one cursor, the count of buffers it has finished, and is
+// the only writer of that cursor (release); the others only read
+// it (acquire). So slot i belongs to:
+// - reader:    nwritten - nbuf <= i, i >= nread
+// - scaler:    nscaled <= i < nread
+// - writer:    nwritten <= i < nscaled
+// No locks are needed.
+//
+// A stage that finds its next slot not yet available counts one
+// stall and waits, yielding at first, then sleeping.
+//
+// The buffer count (nchk) is fixed up front for files. For a
+// stream it starts unbounded and the reader sets it at EOF.
+//
+struct PipeRing
+{
+    std::vector<std::vector<char> > buf;
+    std::vector<qint64>             tpts;   // timepoints in slot
+    QAtomicInteger<qint64>          nread,
+                                    nscaled,
+                                    nwritten,
+                                    nchk;
+    QAtomicInt                      fail;
+    qint64                          nbuf;
+    qint64                          stalls[3];
+    double                          waits[3];
+
+    PipeRing( qint64 nbuf, qint64 bufbytes, qint64 nchk )
+    :   buf(nbuf, std::vector<char>( bufbytes )), tpts(nbuf, 0),
+        nread(0), nscaled(0), nwritten(0), nchk(nchk), fail(0),
+        nbuf(nbuf)
+        {
+            for( int i = 0; i < 3; ++i ) {
+                stalls[i]   = 0;
+                waits[i]    = 0;
+            }
+        }
+
+    bool waitFor(
+        int                             stage,
+        const QAtomicInteger<qint64>    &cursor,
+        qint64                          need );
+};
+
+
+// Wait until (cursor) >= (need), or failure, or (need) is
+// past the end of the stream.
+//
+// Return false if failed or ended.
+//
+bool PipeRing::waitFor(
+    int                             stage,
+    const QAtomicInteger<qint64>    &cursor,
+    qint64                          need )
+{
+    if( cursor.loadAcquire() >= need )
+        return !fail.load();
+
+    if( need > nchk.loadAcquire() )
+        return false;
+
+    double  t0 = getTime();
+    int     spin = 0;
+
+    ++stalls[stage];
+
+    while( cursor.loadAcquire() < need ) {
+
+        if( fail.load() || need > nchk.loadAcquire() )
+            return false;
+
+        if( ++spin < 64 )
+            QThread::yieldCurrentThread();
+        else
+            QThread::usleep( 100 );
+    }
+
+    waits[stage] += getTime() - t0;
+
+    return !fail.load();
+}
+
+/* ---------------------------------------------------------------- */
+/* PipeReader, PipeWriter ----------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+enum PipeStage {
+    psRead  = 0,
+    psScale = 1,
+    psWrite = 2
+};
+
+
+// Reads (ntpts) from fa; or if (ntpts) < 0, reads a stream until
+// EOF, dropping any trailing partial timepoint.
+//
+class PipeReader : public QThread
+{
+private:
+    PipeRing    &R;
+    QFile       &fa;
+    qint64      tpbytes,
+                ntpts,
+                buftpts,
+                ndrop;
+
+public:
+    PipeReader(
+        PipeRing    &R,
+        QFile       &fa,
+        qint64      tpbytes,
+        qint64      ntpts,
+        qint64      buftpts )
+    :   R(R), fa(fa), tpbytes(tpbytes), ntpts(ntpts), buftpts(buftpts),
+        ndrop(0)                                                {}
+
+    qint64 dropped() const  {return ndrop;}
+
+protected:
+    virtual void run();
+
+private:
+    void runStream();
+};
+
+
+void PipeReader::run()
+{
+    if( ntpts < 0 ) {
+        runStream();
+        return;
+    }
+
+    for( qint64 i = 0, n = R.nchk.load(); i < n; ++i ) {
+
+        // Slot free once writer has finished buffer (i - nbuf)
+
+        if( !R.waitFor( psRead, R.nwritten, i - R.nbuf + 1 ) )
+            return;
+
+        qint64  islot   = i % R.nbuf,
+                nt      = qMin( buftpts, ntpts - i * buftpts ),
+                bytes   = nt * tpbytes;
+
+        if( fa.read( &R.buf[islot][0], bytes ) != bytes ) {
+            R.fail.store( 1 );
+            return;
+        }
+
+        R.tpts[islot] = nt;
+        R.nread.storeRelease( i + 1 );
+    }
+}
+
+
+// Pipe reads return what's available, so each slot is filled by
+// repeated reads. Bytes past the last whole timepoint carry over
+// to the next slot.
+//
+void PipeReader::runStream()
+{
+    std::vector<char>   carry;
+    qint64              bufbytes = buftpts * tpbytes;
+
+    for( qint64 i = 0;; ++i ) {
+
+        if( !R.waitFor( psRead, R.nwritten, i - R.nbuf + 1 ) )
+            return;
+
+        qint64  islot   = i % R.nbuf,
+                have    = carry.size();
+        char    *b      = &R.buf[islot][0];
+        bool    eof     = false;
+
+        if( have )
+            memcpy( b, &carry[0], have );
+
+        while( have < bufbytes ) {
+
+            qint64  got = fa.read( b + have, bufbytes - have );
+
+            if( got < 0 ) {
+                R.fail.store( 1 );
+                return;
+            }
+
+            if( !got ) {
+                eof = true;
+                break;
+            }
+
+            have += got;
+        }
+
+        qint64  nt = have / tpbytes;
+
+        carry.assign( b + nt * tpbytes, b + have );
+
+        if( nt ) {
+            R.tpts[islot] = nt;
+            R.nread.storeRelease( i + 1 );
+        }
+
+        if( eof ) {
+            ndrop = carry.size();
+            R.nchk.storeRelease( nt ? i + 1 : i );
+            return;
+        }
+    }
+}
+
+
+// Writes, and feeds (out), each buffer in turn; buffers
+// hold timepoints of (tpbytes), as packed by the scaler.
+//
+class PipeWriter : public QThread
+{
+private:
+    PipeRing        &R;
+    QFile           &fb;
+    const OutDigest &out;
+    qint64          tpbytes;
+
+public:
+    PipeWriter(
+        PipeRing        &R,
+        QFile           &fb,
+        const OutDigest &out,
+        qint64          tpbytes )
+    :   R(R), fb(fb), out(out), tpbytes(tpbytes)    {}
+
+protected:
+    virtual void run();
+};
+
+
+void PipeWriter::run()
+{
+    for( qint64 i = 0; R.waitFor( psWrite, R.nscaled, i + 1 ); ++i ) {
+
+        qint64  islot   = i % R.nbuf,
+                bytes   = R.tpts[islot] * tpbytes;
+
+        if( fb.write( &R.buf[islot][0], bytes ) != bytes ) {
+            R.fail.store( 1 );
+            return;
+        }
+
+        out.add( &R.buf[islot][0], bytes );
+
+        R.nwritten.storeRelease( i + 1 );
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* CbinRing, CbinThread ------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Slots handed encoders -> writer for Scaler::compressed().
+//
+// Chunk i uses slot (i % nslot). An encoder may claim chunk i once
+// the writer has written chunk (i - nslot); it reads, scales and
+// encodes it, then publishes ready = i + 1. The writer takes
+// chunks strictly in order, so the .cbin is written sequentially
+// though chunks finish in any order.
+//
+struct CbinSlot {
+    std::vector<qint16>     buf,    // scaled
+                            tmp;    // differences
+    QByteArray              z;      // encoded
+    QAtomicInteger<qint64>  ready;
+};
+
+struct CbinRing
+{
+    std::vector<CbinSlot>   slot;
+    QAtomicInteger<qint64>  next,
+                            nwritten;
+    QAtomicInt              fail;
+    qint64                  nslot;
+
+    CbinRing( qint64 nslot )
+    :   slot(nslot), next(0), nwritten(0), fail(0), nslot(nslot)  {}
+
+    bool waitFor( const QAtomicInteger<qint64> &cursor, qint64 need );
+};
+
+
+// Return false if failed.
+//
+bool CbinRing::waitFor( const QAtomicInteger<qint64> &cursor, qint64 need )
+{
+    for( int spin = 0; cursor.loadAcquire() < need; ++spin ) {
+
+        if( fail.load() )
+            return false;
+
+        if( spin < 64 )
+            QThread::yieldCurrentThread();
+        else
+            QThread::usleep( 100 );
+    }
+
+    return !fail.load();
+}
+
+
+class CbinThread : public QThread
+{
+private:
+    const Plan      &P;
+    const Cbin      &C,
+                    *ca;
+    const Gather    *gt;
+    CbinRing        &R;
+    HashPump        &pump;
+    QFile           &fa;
+    qint64          tpbytes,
+                    tbase;
+
+public:
+    CbinThread(
+        const Plan      &P,
+        const Cbin      &C,
+        const Cbin      *ca,
+        const Gather    *gt,
+        CbinRing        &R,
+        HashPump        &pump,
+        QFile           &fa,
+        qint64          tpbytes,
+        qint64          tbase )
+    :   P(P), C(C), ca(ca), gt(gt), R(R), pump(pump), fa(fa),
+        tpbytes(tpbytes), tbase(tbase)                      {}
+
+protected:
+    virtual void run();
+};
+
+
+void CbinThread::run()
+{
+    std::vector<char>   z;
+    std::vector<qint16> tmp;
+    qint64              nchk = C.nChunks();
+
+    for(;;) {
+
+        qint64  ichk = R.next.fetchAndAddOrdered( 1 );
+
+        if( ichk >= nchk || !R.waitFor( R.nwritten, ichk - R.nslot + 1 ) )
+            break;
+
+        CbinSlot    &X      = R.slot[ichk % R.nslot];
+        qint64      nt      = C.bounds[ichk + 1] - C.bounds[ichk],
+                    bytes   = nt * tpbytes;
+
+        X.buf.resize( nt * P.nC );
+        X.tmp.resize( nt * C.nC );
+
+        if( ca ) {
+
+            if( !ca->read( fa, &X.buf[0], tbase + C.bounds[ichk], nt, z, tmp ) ) {
+                R.fail.store( 1 );
+                break;
+            }
+        }
+        else if( readAt( fa, (char*)&X.buf[0], bytes,
+                    (tbase + C.bounds[ichk]) * tpbytes ) != bytes ) {
+
+            R.fail.store( 1 );
+            break;
+        }
+
+        if( !pump.add( ichk, (const char*)&X.buf[0], bytes ) )
+            break;
+
+        scaleKeep( P, gt, &X.buf[0], nt );
+        C.encode( X.z, &X.tmp[0], &X.buf[0], nt );
+
+        X.ready.storeRelease( ichk + 1 );
+    }
+}
+
+/* ---------------------------------------------------------------- */
+/* Journal -------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Redo journal for Scaler::inPlace().
+//
+// Layout: JHdr at offset 0 (one sector, so rewritten atomically),
+// then the scaled image of the pending chunk at JDATA.
+//
+// For each chunk i:
+// (1) write scaled chunk to journal data, sync;
+// (2) header {ndone=i, pending}, sync;
+// (3) write scaled chunk over the bin, sync;
+// (4) header {ndone=i+1, clean}, sync.
+//
+// After a crash, chunks < ndone are done and chunks > ndone are
+// raw. If pending, chunk ndone may be partly written, so it is
+// replayed from the journal; replay is idempotent.
+//
+#define JMAGIC      0x4A53494E  // 'NISJ'
+#define JDATA       4096
+
+struct JHdr {
+    quint32 magic,
+            pending;
+    qint64  fbytes,     // bin size
+            chkbytes,   // chunk size
+            ndone,      // chunks committed
+            offset,     // pending chunk's bin offset
+            bytes;      // pending chunk's length
+    char    md5[16];    // pending chunk's data
+
+    JHdr()  {memset( this, 0, sizeof(JHdr) );}
+};
+
+
+static bool writeJHdr( QFile &fj, const JHdr &H )
+{
+    return writeAt( fj, (const char*)&H, sizeof(JHdr), 0 ) == sizeof(JHdr)
+            && syncFile( fj );
+}
+
+
+static void md5( char out[16], const char *data, qint64 bytes )
+{
+    QByteArray  h = QCryptographicHash::hash(
+                        QByteArray::fromRawData( data, bytes ),
+                        QCryptographicHash::Md5 );
+
+    memcpy( out, h.constData(), 16 );
+}
+
+/* ---------------------------------------------------------------- */
+/* Scaler --------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+Scaler::Scaler( const Plan &P, QFile &fa, QFile &fb )
+    :   P(P), fa(fa), fb(fb), ca(0), gt(0), hash(0), srcHash(0), crc(0)
+{
+    tpbytes = 2 * P.nC;
+    otpbytes= tpbytes;
+    ntpts   = fa.size() / tpbytes;
+    twin    = 0;
+    tbeg    = 0;
+    tend    = ntpts;
+
+    for( int i = 0; i < 3; ++i ) {
+        pipeStalls[i]   = 0;
+        pipeWaits[i]    = 0;
+    }
+}
+
+
+int Scaler::name2Engine( const QString &name )
+{
+    if( name == "serial" )
+        return eSerial;
+    else if( name == "pipe" )
+        return ePipe;
+    else if( name == "mmap" )
+        return eMmap;
+    else if( name == "uring" )
+        return eUring;
+    else if( name == "direct" )
+        return eDirect;
+
+    return -1;
+}
+
+
+// Smallest whole count of timepoints spanning a whole count of
+// (DIRECTALIGN) blocks, in both fa and fb.
+//
+qint64 Scaler::alignTpts() const
+{
+    qint64  n = 1;
+
+    while( (n * tpbytes) % DIRECTALIGN || (n * otpbytes) % DIRECTALIGN )
+        ++n;
+
+    return n;
+}
+
+
+// Checkpoint span: about (SEGBYTES), and block aligned
+// so that any engine can resume at a segment boundary.
+//
+qint64 Scaler::segTpts() const
+{
+    qint64  a = alignTpts();
+
+    return qMax( qint64(1), SEGBYTES / (a * tpbytes) ) * a;
+}
+
+
+// Return false if (C) doesn't match the plan.
+//
+bool Scaler::setSource( const Cbin &C )
+{
+    if( C.nC != P.nC )
+        return false;
+
+    ca      = &C;
+    ntpts   = C.tpts();
+    twin    = 0;
+    tbeg    = 0;
+    tend    = ntpts;
+
+    return true;
+}
+
+
+// Return false if (g) doesn't match the plan.
+//
+bool Scaler::setGather( const Gather *g )
+{
+    if( g && g->nchans != P.nC )
+        return false;
+
+    gt          = (g && !g->isAll()) ? g : 0;
+    otpbytes    = gt ? 2 * gt->nkeep : tpbytes;
+
+    return true;
+}
+
+
+// Return false if window is empty or out of range.
+//
+bool Scaler::setWindow( qint64 t0, qint64 t1 )
+{
+    if( t0 < 0 || t1 <= t0 || t1 > ntpts )
+        return false;
+
+    twin    = t0;
+    ntpts   = t1 - t0;
+    tbeg    = 0;
+    tend    = ntpts;
+
+    return true;
+}
+
+
+void Scaler::logPipeStats() const
+{
+    Log() <<
+        QString("    Pipe stalls: read %1 (%2 s), scale %3 (%4 s),"
+                " write %5 (%6 s).")
+        .arg( pipeStalls[psRead] ).arg( pipeWaits[psRead], 0, 'f', 3 )
+        .arg( pipeStalls[psScale] ).arg( pipeWaits[psScale], 0, 'f', 3 )
+        .arg( pipeStalls[psWrite] ).arg( pipeWaits[psWrite], 0, 'f', 3 );
+}
+
+
+// One buffer, one thread: read, scale, write.
+//
+// Return true if no errors.
+//
+bool Scaler::serial()
+{
+    qint64              buftpts = qMax( qint64(1), BUFBYTES / tpbytes ),
+                        asmp    = tend - tbeg;
+    std::vector<char>   buf( buftpts * tpbytes );
+    OutDigest           out( hash, crc );
+    QAtomicInt          fail( 0 );
+    HashPump            pump( srcHash, fail );
+
+    if( !fa.seek( (twin + tbeg) * tpbytes ) || !fb.seek( tbeg * otpbytes ) )
+        return false;
+
+    pump.begin();
+
+    for( qint64 i = 0; asmp; ++i ) {
+
+        qint64  smp     = qMin( buftpts, asmp ),
+                bytes   = smp * tpbytes,
+                obytes  = smp * otpbytes;
+
+        if( fa.read( &buf[0], bytes ) != bytes )
+            return false;
+
+        pump.add( i, &buf[0], bytes );
+
+        scaleKeep( P, gt, (qint16*)&buf[0], smp );
+
+        if( fb.write( &buf[0], obytes ) != obytes )
+            return false;
+
+        out.add( &buf[0], obytes );
+
+        asmp -= smp;
+    }
+
+    return true;
+}
+
+
+// Three stages over a ring of (PIPEBUFS) buffers: a reader thread
+// fills, this thread scales, a writer thread drains. Reading the
+// next buffer and writing the previous one overlap scaling of the
+// current one.
+//
+// Stall counts tell where the bottleneck is:
+// - reader stalls: ring full, waiting on writer (or scaler).
+// - scaler stalls: waiting on reader.
+// - writer stalls: waiting on scaler.
+// Counts accumulate over calls; see logPipeStats().
+//
+// Return true if no errors.
+//
+bool Scaler::pipelined()
+{
+    qint64  buftpts = qMax( qint64(1), PIPEBYTES / tpbytes ),
+            nchk    = (tend - tbeg + buftpts - 1) / buftpts;
+
+    if( !fa.seek( (twin + tbeg) * tpbytes ) || !fb.seek( tbeg * otpbytes ) )
+        return false;
+
+    OutDigest   out( hash, crc );
+    PipeRing    R( PIPEBUFS, buftpts * tpbytes, nchk );
+    PipeReader  rd( R, fa, tpbytes, tend - tbeg, buftpts );
+    PipeWriter  wr( R, fb, out, otpbytes );
+    HashPump    pump( srcHash, R.fail );
+
+    rd.start();
+    wr.start();
+    pump.begin();
+
+    for( qint64 i = 0; i < nchk; ++i ) {
+
+        if( !R.waitFor( psScale, R.nread, i + 1 ) )
+            break;
+
+        qint64  islot = i % R.nbuf;
+
+        if( !pump.add( i, &R.buf[islot][0], R.tpts[islot] * tpbytes ) )
+            break;
+
+        scaleKeep( P, gt, (qint16*)&R.buf[islot][0], R.tpts[islot] );
+
+        R.nscaled.storeRelease( i + 1 );
+    }
+
+    rd.wait();
+    wr.wait();
+
+    for( int i = 0; i < 3; ++i ) {
+        pipeStalls[i]   += R.stalls[i];
+        pipeWaits[i]    += R.waits[i];
+    }
+
+    return !R.fail.load();
+}
+
+
+// Stream: pipelined() from fa to fb until fa reaches EOF, for
+// pipes and other sequential devices of unknown length. Open
+// both Unbuffered; large ring buffers keep the pipes busy.
+// On return, tpts() counts the timepoints scaled.
+//
+// Return true if no errors.
+//
+bool Scaler::streamed()
+{
+    qint64  buftpts = qMax( qint64(1), PIPEBYTES / tpbytes );
+
+    OutDigest   out( hash, crc );
+    PipeRing    R( PIPEBUFS, buftpts * tpbytes,
+                    Q_INT64_C(0x7FFFFFFFFFFFFFFF) );
+    PipeReader  rd( R, fa, tpbytes, -1, buftpts );
+    PipeWriter  wr( R, fb, out, otpbytes );
+    HashPump    pump( srcHash, R.fail );
+
+    rd.start();
+    wr.start();
+    pump.begin();
+
+    ntpts = 0;
+
+    for( qint64 i = 0; R.waitFor( psScale, R.nread, i + 1 ); ++i ) {
+
+        qint64  islot = i % R.nbuf;
+
+        if( !pump.add( i, &R.buf[islot][0], R.tpts[islot] * tpbytes ) )
+            break;
+
+        scaleKeep( P, gt, (qint16*)&R.buf[islot][0], R.tpts[islot] );
+        ntpts += R.tpts[islot];
+
+        R.nscaled.storeRelease( i + 1 );
+    }
+
+    rd.wait();
+    wr.wait();
+
+    for( int i = 0; i < 3; ++i ) {
+        pipeStalls[i]   += R.stalls[i];
+        pipeWaits[i]    += R.waits[i];
+    }
+
+    if( rd.dropped() ) {
+        Log() << QString("    Dropped %1 trailing bytes (partial timepoint).")
+                    .arg( rd.dropped() );
+    }
+
+    return !R.fail.load();
+}
+
+
+// Memory-mapped: scale straight from mapped fa pages into mapped
+// fb pages. fb is preallocated to outBytes() and must be open
+// ReadWrite. Windows of (MAPBYTES) are mapped, scaled and
+// unmapped in turn, which bounds address space and RSS for
+// files of any size.
+//
+// With a Gather, blocks are scaled in a small buffer and only
+// the kept channels are packed into fb.
+//
+// Return true if no errors.
+//
+bool Scaler::mapped()
+{
+    if( !fb.resize( outBytes() ) )
+        return false;
+
+    qint64              wintpts = qMax( qint64(1), MAPBYTES / tpbytes ),
+                        buftpts = qMax( qint64(1), BUFBYTES / tpbytes );
+    std::vector<qint16> buf;
+    OutDigest           out( hash, crc );
+    QAtomicInt          fail( 0 );
+    HashPump            pump( srcHash, fail );
+
+    if( gt )
+        buf.resize( buftpts * P.nC );
+
+    pump.begin();
+
+    for( qint64 t0 = tbeg, i = 0; t0 < tend; t0 += wintpts, ++i ) {
+
+        qint64  nt      = qMin( wintpts, tend - t0 ),
+                winbytes= nt * tpbytes,
+                outbytes= nt * otpbytes;
+        uchar   *src    = fa.map( (twin + t0) * tpbytes, winbytes ),
+                *dst    = fb.map( t0 * otpbytes, outbytes );
+
+        if( !src || !dst ) {
+
+            if( src )
+                fa.unmap( src );
+
+            if( dst )
+                fb.unmap( dst );
+
+            return false;
+        }
+
+        adviseSequential( src, winbytes );
+        adviseSequential( dst, outbytes );
+
+        pump.add( i, (const char*)src, winbytes );
+
+        if( !gt )
+            P.apply( (qint16*)dst, (const qint16*)src, nt );
+        else {
+
+            for( qint64 t = 0; t < nt; t += buftpts ) {
+
+                qint64  n = qMin( buftpts, nt - t );
+
+                memcpy( &buf[0], src + t * tpbytes, n * tpbytes );
+                P.apply( &buf[0], n );
+                gt->apply( (qint16*)(dst + t * otpbytes), &buf[0], n );
+            }
+        }
+
+        out.add( (const char*)dst, outbytes );
+
+        fa.unmap( src );
+        fb.unmap( dst );
+    }
+
+    return true;
+}
+
+
+// Asynchronous: keep (URINGDEPTH) buffers of (URINGBYTES) in
+// flight through io_uring. Each buffer cycles read -> scale ->
+// write -> read next free chunk, so the device sees a deep queue
+// while this thread scales whichever read completes first.
+// Short transfers are resubmitted for the remainder.
+//
+// If hashing, chunks are scaled (and hashed) in file order; a
+// read that completes early waits in its slot for its turn.
+//
+// Falls back to pipelined() if io_uring is unavailable.
+//
+// Return true if no errors.
+//
+bool Scaler::queued()
+{
+    // Reads come from fa timepoint (twin + t0), writes go to
+    // fb timepoint (t0); (bytes) is the current transfer.
+
+    struct Slot {
+        std::vector<char>   buf;
+        qint64              ichk,
+                            t0,
+                            nt,
+                            bytes,
+                            done;
+        bool                loaded,
+                            writing;
+    };
+
+    qint64              chktpts = qMax( qint64(1), URINGBYTES / tpbytes ),
+                        nt      = tend - tbeg,
+                        nchk    = (nt + chktpts - 1) / chktpts,
+                        next    = 0,
+                        nscaled = 0,
+                        nfin    = 0;
+    std::vector<Slot>   S( qMin( qint64(URINGDEPTH), nchk ) );
+    Uring               U;
+
+    if( !U.init( URINGDEPTH ) ) {
+
+        static bool logged = false;
+
+        if( !logged ) {
+            Log() << "    io_uring unavailable; using pipe engine.";
+            logged = true;
+        }
+
+        return pipelined();
+    }
+
+    int                 ifd         = fa.handle(),
+                        ofd         = fb.handle(),
+                        inflight    = 0;
+    OutDigest           out( hash, crc );
+    QAtomicInt          fail( 0 );
+    HashPump            pump( srcHash, fail );
+    bool                inorder     = out.on() || srcHash,
+                        ok          = true;
+
+    pump.begin();
+
+    for( int is = 0, ns = S.size(); is < ns; ++is ) {
+
+        Slot    &X = S[is];
+
+        X.buf.resize( chktpts * tpbytes );
+        X.ichk      = next;
+        X.t0        = tbeg + next * chktpts;
+        X.nt        = qMin( chktpts, nt - next * chktpts );
+        X.bytes     = X.nt * tpbytes;
+        X.done      = 0;
+        X.loaded    = false;
+        X.writing   = false;
+        ++next;
+
+        if( !U.queueRead( ifd, &X.buf[0], X.bytes,
+                (twin + X.t0) * tpbytes, is ) ) {
+
+            ok = false;
+            break;
+        }
+
+        ++inflight;
+    }
+
+    // After an error nothing new is queued, but every request
+    // must complete before (S) is freed; closing the ring does
+    // not wait for them. If io_uring_enter keeps failing, cancel
+    // what remains; if even that can't be reaped, leak (S) rather
+    // than free buffers the kernel may still fill.
+
+    int nerr = 0;
+
+    while( inflight > 0 ) {
+
+        if( U.submitAndWait( 1 ) < 0 ) {
+
+            ok = false;
+
+            if( ++nerr == URINGRETRY ) {
+
+                for( int is = 0, ns = S.size(); is < ns; ++is )
+                    inflight += U.queueCancel( is, URINGCANCEL + is );
+            }
+            else if( nerr >= 2 * URINGRETRY ) {
+
+                Log() << "    io_uring requests stuck; abandoning their buffers.";
+                (new std::vector<Slot>)->swap( S );
+                return false;
+            }
+
+            QThread::usleep( 1000 );
+        }
+        else
+            nerr = 0;
+
+        quint64 tag;
+        int     res;
+
+        while( U.reap( tag, res ) ) {
+
+            --inflight;
+
+            if( !ok )
+                continue;
+
+            Slot    &X = S[tag];
+
+            if( res == -EINTR || res == -EAGAIN )
+                res = 0;
+            else if( res < 0 || (!res && !X.writing) ) {
+                ok = false;
+                continue;
+            }
+
+            X.done += res;
+
+            if( X.done < X.bytes ) {
+
+                // Resubmit remainder
+
+                if( X.writing ) {
+                    ok = U.queueWrite( ofd, &X.buf[X.done], X.bytes - X.done,
+                            X.t0 * otpbytes + X.done, tag );
+                }
+                else {
+                    ok = U.queueRead( ifd, &X.buf[X.done], X.bytes - X.done,
+                            (twin + X.t0) * tpbytes + X.done, tag );
+                }
+
+                inflight += ok;
+            }
+            else if( !X.writing ) {
+
+                X.loaded = true;
+
+                for( int is = int(tag); is >= 0 && ok; ) {
+
+                    // Next slot to scale: this one, or in order
+
+                    if( inorder ) {
+
+                        is = -1;
+
+                        for( int js = 0, ns = S.size(); js < ns; ++js ) {
+
+                            if( S[js].loaded && S[js].ichk == nscaled )
+                                is = js;
+                        }
+
+                        if( is < 0 )
+                            break;
+                    }
+
+                    Slot    &Y = S[is];
+
+                    pump.add( Y.ichk, &Y.buf[0], Y.bytes );
+
+                    scaleKeep( P, gt, (qint16*)&Y.buf[0], Y.nt );
+
+                    Y.bytes     = Y.nt * otpbytes;
+                    Y.done      = 0;
+                    Y.loaded    = false;
+                    Y.writing   = true;
+
+                    out.add( &Y.buf[0], Y.bytes );
+
+                    ++nscaled;
+
+                    ok = U.queueWrite( ofd, &Y.buf[0], Y.bytes,
+                            Y.t0 * otpbytes, is );
+
+                    inflight += ok;
+
+                    if( !inorder )
+                        break;
+                }
+            }
+            else if( ++nfin < nchk && next < nchk ) {
+
+                // Reuse slot for next chunk
+
+                X.ichk      = next;
+                X.t0        = tbeg + next * chktpts;
+                X.nt        = qMin( chktpts, nt - next * chktpts );
+                X.bytes     = X.nt * tpbytes;
+                X.done      = 0;
+                X.writing   = false;
+                ++next;
+
+                ok = U.queueRead( ifd, &X.buf[0], X.bytes,
+                        (twin + X.t0) * tpbytes, tag );
+
+                inflight += ok;
+            }
+        }
+    }
+
+    return ok && nfin == nchk;
+}
+
+
+// Direct: like threaded(), but bypassing the page cache, so a
+// large batch does not evict other data. Files should be opened
+// with openDirect(); that needs sector-aligned buffers, offsets
+// and lengths, so chunks are whole multiples of both a timepoint
+// and (DIRECTALIGN). fb is preallocated, the final chunk is
+// padded to a full block, and fb is then trimmed to outBytes().
+// A range must start on a segTpts() boundary.
+//
+// At least (DIRECTTHREADS) workers keep requests queued, since
+// direct I/O gets no read-ahead or write-behind.
+//
+// Return true if no errors.
+//
+bool Scaler::direct( int nthd )
+{
+    qint64  a       = alignTpts(),
+            chktpts = qMax( qint64(1), CHUNKBYTES / (a * tpbytes) ) * a;
+
+    if( !tbeg )
+        preallocate( fb, outBytes() );
+
+    if( !sliced( qMax( nthd, DIRECTTHREADS ), chktpts, DIRECTALIGN ) )
+        return false;
+
+    return tend < ntpts || fb.resize( outBytes() );
+}
+
+
+// In place: fa == fb, opened ReadWrite | Unbuffered. Each chunk
+// is scaled and written back at the same offset, with the redo
+// journal (jpath) making every step restartable. If (jpath)
+// exists, the interrupted run is first finished from it.
+//
+// Caller removes (jpath) after committing the metafile.
+//
+// Return true if no errors.
+//
+bool Scaler::inPlace( const QString &jpath )
+{
+    QFile   fj( jpath );
+    JHdr    H;
+    qint64  chktpts = qMax( qint64(1), JOURNALBYTES / tpbytes ),
+            nchk    = (ntpts + chktpts - 1) / chktpts;
+    bool    resume;
+
+    if( !fj.open( QIODevice::ReadWrite | QIODevice::Unbuffered ) ) {
+        Log() << QString("    Can't open journal '%1'.").arg( jpath );
+        return false;
+    }
+
+    // No complete header means we stopped before touching the bin
+
+    resume = fj.size() >= qint64(sizeof(JHdr));
+
+    std::vector<char>   buf( chktpts * tpbytes );
+
+    if( resume ) {
+
+        if( readAt( fj, (char*)&H, sizeof(JHdr), 0 ) != sizeof(JHdr)
+            || H.magic != JMAGIC
+            || H.fbytes != fa.size()
+            || H.chkbytes != chktpts * tpbytes
+            || H.ndone > nchk
+            || H.pending > 1
+            || (H.pending
+                && (H.ndone >= nchk
+                    || H.bytes <= 0
+                    || H.bytes > H.chkbytes
+                    || H.offset != H.ndone * H.chkbytes
+                    || H.offset + H.bytes > H.fbytes)) ) {
+
+            Log() << QString("    Journal doesn't match bin '%1'.").arg( jpath );
+            return false;
+        }
+
+        if( H.pending ) {
+
+            char    sum[16];
+
+            if( readAt( fj, &buf[0], H.bytes, JDATA ) != H.bytes )
+                return false;
+
+            md5( sum, &buf[0], H.bytes );
+
+            if( memcmp( sum, H.md5, 16 ) ) {
+                Log() << QString("    Journal is corrupt '%1'.").arg( jpath );
+                return false;
+            }
+
+            if( writeAt( fa, &buf[0], H.bytes, H.offset ) != H.bytes
+                || !syncFile( fa ) ) {
+
+                return false;
+            }
+
+            ++H.ndone;
+            H.pending = 0;
+
+            if( !writeJHdr( fj, H ) )
+                return false;
+        }
+
+        Log() << QString("    Resuming at chunk %1 of %2.")
+                    .arg( H.ndone ).arg( nchk );
+    }
+    else {
+
+        H.magic     = JMAGIC;
+        H.fbytes    = fa.size();
+        H.chkbytes  = chktpts * tpbytes;
+
+        if( !writeJHdr( fj, H ) )
+            return false;
+    }
+
+    // Hashing: read back chunks done in earlier run
+
+    OutDigest   out( hash, crc );
+
+    for( qint64 ichk = 0; out.on() && ichk < H.ndone; ++ichk ) {
+
+        qint64  bytes   = qMin( chktpts, ntpts - ichk * chktpts ) * tpbytes;
+
+        if( readAt( fa, &buf[0], bytes, ichk * chktpts * tpbytes ) != bytes )
+            return false;
+
+        out.add( &buf[0], bytes );
+    }
+
+    QAtomicInt  fail( 0 );
+    HashPump    pump( srcHash, fail );
+
+    pump.begin();
+
+    for( qint64 ichk = H.ndone; ichk < nchk; ++ichk ) {
+
+        qint64  t0      = ichk * chktpts,
+                nt      = qMin( chktpts, ntpts - t0 ),
+                bytes   = nt * tpbytes,
+                offset  = t0 * tpbytes;
+
+        if( readAt( fa, &buf[0], bytes, offset ) != bytes )
+            return false;
+
+        pump.add( ichk - H.ndone, &buf[0], bytes );
+
+        P.apply( (qint16*)&buf[0], nt );
+
+        out.add( &buf[0], bytes );
+
+        // (1), (2)
+
+        if( writeAt( fj, &buf[0], bytes, JDATA ) != bytes
+            || !syncFile( fj ) ) {
+
+            return false;
+        }
+
+        H.pending   = 1;
+        H.offset    = offset;
+        H.bytes     = bytes;
+        md5( H.md5, &buf[0], bytes );
+
+        if( !writeJHdr( fj, H ) )
+            return false;
+
+        // (3)
+
+        if( writeAt( fa, &buf[0], bytes, offset ) != bytes
+            || !syncFile( fa ) ) {
+
+            return false;
+        }
+
+        // (4)
+
+        H.ndone     = ichk + 1;
+        H.pending   = 0;
+
+        if( !writeJHdr( fj, H ) )
+            return false;
+    }
+
+    return true;
+}
+
+
+// Time-sliced: (nthd) workers share the file by chunks of
+// whole timepoints using positional reads and writes.
+// Files must be opened Unbuffered.
+//
+// A compressed source is sliced by its own chunk size, so
+// each worker decodes whole chunks.
+//
+// Return true if no errors.
+//
+bool Scaler::threaded( int nthd )
+{
+    if( ca )
+        return sliced( nthd, qMax( qint64(1), ca->bounds[1] ), 1 );
+
+    return sliced( nthd, qMax( qint64(1), CHUNKBYTES / tpbytes ), 1 );
+}
+
+
+bool Scaler::sliced( int nthd, qint64 chktpts, int align )
+{
+    QAtomicInt                  next( 0 ),
+                                fail( 0 );
+    OutDigest                   out( hash, crc );
+    OrderedHash                 oh( out, fail );
+    HashPump                    pump( srcHash, fail );
+    std::vector<ScaleThread*>   vT;
+
+    pump.begin();
+
+    for( int i = 0; i < nthd; ++i ) {
+
+        vT.push_back(
+            new ScaleThread(
+                P, ca, gt, out.on() ? &oh : 0, pump, fa, fb, next, fail,
+                tpbytes, otpbytes, tbeg, twin, tend - tbeg,
+                chktpts, align ) );
+
+        vT[i]->start();
+    }
+
+    for( int i = 0; i < nthd; ++i ) {
+        vT[i]->wait();
+        delete vT[i];
+    }
+
+    return !fail.load();
+}
+
+
+
+// Compressed: (nthd) encoders read, scale and encode the chunks
+// of (C), which the caller has bounded relative to tbeg; this
+// thread appends them in order to fb, filling in the chunk
+// offsets and SHA1s of C. Files must be opened Unbuffered.
+//
+// Return true if no errors.
+//
+bool Scaler::compressed( int nthd, Cbin &C )
+{
+    QCryptographicHash          hc( QCryptographicHash::Sha1 ),
+                                hu( QCryptographicHash::Sha1 );
+    CbinRing                    R( 2 * nthd );
+    HashPump                    pump( srcHash, R.fail );
+    std::vector<CbinThread*>    vT;
+    qint64                      nchk = C.nChunks();
+
+    C.nC = otpbytes / sizeof(qint16);
+    C.offsets.assign( 1, 0 );
+
+    pump.begin();
+
+    for( int i = 0; i < nthd; ++i ) {
+        vT.push_back(
+            new CbinThread( P, C, ca, gt, R, pump, fa, tpbytes, twin + tbeg ) );
+        vT[i]->start();
+    }
+
+    for( qint64 i = 0; i < nchk; ++i ) {
+
+        CbinSlot    &X      = R.slot[i % R.nslot];
+        int         ubytes  = (C.bounds[i + 1] - C.bounds[i]) * otpbytes;
+
+        if( !R.waitFor( X.ready, i + 1 ) )
+            break;
+
+        if( fb.write( X.z ) != X.z.size() ) {
+            R.fail.store( 1 );
+            break;
+        }
+
+        hc.addData( X.z );
+        hu.addData( (const char*)&X.buf[0], ubytes );
+
+        if( hash )
+            hash->addData( (const char*)&X.buf[0], ubytes );
+
+        C.offsets.push_back( C.offsets.back() + X.z.size() );
+
+        R.nwritten.storeRelease( i + 1 );
+    }
+
+    for( int i = 0; i < nthd; ++i ) {
+        vT[i]->wait();
+        delete vT[i];
+    }
+
+    C.sha1c = QString( hc.result().toHex() );
+    C.sha1u = QString( hu.result().toHex() );
+
+    return !R.fail.load();
+}
+
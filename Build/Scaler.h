@@ -0,0 +1,118 @@
+#ifndef SCALER_H
+#define SCALER_H
+
+#include <QFile>
+#include <QString>
+
+class Cbin;
+class ChunkCrc;
+class Gather;
+class QCryptographicHash;
+struct Plan;
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Scale one bin file, src (fa) to dst (fb).
+//
+// Engines move whole timepoints and produce byte-identical
+// output; they differ only in how I/O and compute are scheduled.
+// Trailing partial timepoints in fa are dropped.
+//
+// With a Gather, fb gets only its kept channels: every engine
+// packs them right after scaling, and fb offsets and sizes are
+// in output timepoints of outTpBytes().
+//
+class Scaler
+{
+private:
+    const Plan          &P;
+    QFile               &fa,
+                        &fb;
+    const Cbin          *ca;        // compressed fa, or 0
+    const Gather        *gt;        // channels kept, or 0 = all
+    QCryptographicHash  *hash,      // of output, or 0
+                        *srcHash;   // of input, or 0
+    ChunkCrc            *crc;       // of output, or 0
+    qint64              tpbytes,    // bytes/timepoint
+                        otpbytes,   // fb bytes/timepoint
+                        ntpts,      // whole timepoints in fa (or window)
+                        twin,       // fa timepoint at fb start
+                        tbeg,       // range to scale
+                        tend,
+                        pipeStalls[3];
+    double              pipeWaits[3];
+
+public:
+    enum Engine {
+        eSerial,    // read, scale, write in turn
+        ePipe,      // reader || scaler || writer
+        eMmap,      // mapped src -> mapped dst
+        eUring,     // io_uring, many chunks in flight
+        eDirect     // threaded, bypassing page cache
+    };
+
+public:
+    Scaler( const Plan &P, QFile &fa, QFile &fb );
+
+    static int name2Engine( const QString &name );
+
+    qint64 bytes() const        {return ntpts * tpbytes;}
+    qint64 tpBytes() const      {return tpbytes;}
+    qint64 outBytes() const     {return ntpts * otpbytes;}
+    qint64 outTpBytes() const   {return otpbytes;}
+    qint64 tpts() const     {return ntpts;}
+    qint64 segTpts() const;
+
+    // fa is the .cbin of (C). Only threaded()
+    // and compressed() can then read fa.
+    bool setSource( const Cbin &C );
+    bool cbinSource() const {return ca != 0;}
+
+    // Scale only fa's timepoints [t0, t1), written from fb's
+    // start; tpts() and ranges then count window timepoints.
+    // Not for inPlace(); direct() needs t0 block aligned.
+    bool setWindow( qint64 t0, qint64 t1 );
+
+    // Write only (g)'s channels to fb, or all if (g) is 0.
+    // Not for inPlace(); set before segTpts() is used.
+    bool setGather( const Gather *g );
+
+    // Engines below scale timepoints [t0, t1), default all.
+    void setRange( qint64 t0, qint64 t1 )   {tbeg = t0; tend = t1;}
+
+    // Engines feed scaled data to (h), in file order.
+    void setHash( QCryptographicHash *h )   {hash = h;}
+
+    // Engines writing a bin feed scaled data to (c), in file order.
+    void setCrc( ChunkCrc *c )              {crc = c;}
+
+    // Engines feed data read to (h), in file order,
+    // hashed on a separate thread.
+    void setSrcHash( QCryptographicHash *h )    {srcHash = h;}
+
+    void logPipeStats() const;
+
+    bool serial();
+    bool pipelined();
+    bool streamed();
+    bool mapped();
+    bool queued();
+    bool direct( int nthd );
+    bool threaded( int nthd );
+
+    // Write (C)'s chunks of the range to fb as a .cbin.
+    bool compressed( int nthd, Cbin &C );
+
+    // Whole file, restartable via own journal.
+    bool inPlace( const QString &jpath );
+
+private:
+    qint64 alignTpts() const;
+    bool sliced( int nthd, qint64 chktpts, int align );
+};
+
+#endif  // SCALER_H
+
+
@@ -1,8 +1,14 @@
 
 #include "Subset.h"
+#include "SIMD.h"
 
+#include <QMutex>
 #include <QStringList>
 #include <QTextStream>
+#include <QThread>
+
+#include <algorithm>
+#include <map>
 
 
 /* ---------------------------------------------------------------- */
@@ -356,6 +362,8 @@ bool Subset::rngStr2Vec( QVector<uint> &v, const QString &s )
 //
 // In-place operation (dst == src) is allowed.
 //
+// Copying is done by a Gather, vectorized if the CPU allows.
+//
 void Subset::subset(
     vec_i16             &dst,
     vec_i16             &src,
@@ -372,19 +380,15 @@ void Subset::subset(
         return;
     }
 
-    int ntpts = int(src.size()) / nchans;
+    qint64  ntpts = qint64(src.size()) / nchans;
+    Gather  G;
 
     if( &dst != &src )
         dst.resize( ntpts * nk );
 
-    const uint  *K = &iKeep[0];
-    qint16      *D = &dst[0],
-                *S = &src[0];
-
-    for( int it = 0; it < ntpts; ++it, S += nchans ) {
-
-        for( int ik = 0; ik < nk; ++ik )
-            *D++ = S[K[ik]];
+    if( ntpts && nk ) {
+        G.make( iKeep, nchans );
+        G.apply( &dst[0], &src[0], ntpts );
     }
 
     if( &dst == &src )
@@ -400,6 +404,8 @@ void Subset::subset(
 //
 // In-place operation (dst == src) is allowed.
 //
+// Copying is done by a Gather, vectorized if the CPU allows.
+//
 void Subset::subsetBlock(
     vec_i16             &dst,
     vec_i16             &src,
@@ -417,60 +423,290 @@ void Subset::subsetBlock(
         return;
     }
 
-    int ntpts   = int(src.size()) / nchans,
-        ncpy    = nk * sizeof(qint16);
+    qint64          ntpts = qint64(src.size()) / nchans;
+    QVector<uint>   iKeep;
+    Gather          G;
+
+    for( int ic = c0; ic < cLim; ++ic )
+        iKeep.push_back( ic );
 
     if( &dst != &src )
         dst.resize( ntpts * nk );
 
-    qint16  *D = &dst[0],
-            *S = &src[c0];
-
-    for( int it = 0; it < ntpts; ++it, D += nk, S += nchans )
-        memcpy( D, S, ncpy );
+    if( ntpts && nk > 0 ) {
+        G.make( iKeep, nchans );
+        G.apply( &dst[0], &src[0], ntpts );
+    }
 
     if( &dst == &src )
         dst.resize( ntpts * nk );
 }
 
 /* ---------------------------------------------------------------- */
-/* downsample ----------------------------------------------------- */
+/* Gather --------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-// All src channels are downsampled/averaged.
+#define GATHERBLK   1024    // in-place timepoints per pass
+#define GATHERCHKS  256     // layouts remembered by okKernel()
+
+// selfCheck() results by {keep..., nchans}
+static QMutex                               checkMutex;
+static std::map<std::vector<uint>, bool>    checked;
+
+
+void Gather::make( const QVector<uint> &iKeep, int nchans )
+{
+    this->nchans    = nchans;
+    nkeep           = iKeep.size();
+    tpv             = 0;
+    kernel          = kIndex;
+
+    keep.assign( iKeep.begin(), iKeep.end() );
+    run0.clear();
+    runN.clear();
+
+    for( int ik = 0; ik < nkeep; ++ik ) {
+
+        if( ik && keep[ik] == keep[ik-1] + 1 )
+            ++runN.back();
+        else {
+            run0.push_back( keep[ik] );
+            runN.push_back( 1 );
+        }
+    }
+
+    if( !nkeep || isAll() )
+        return;
+
+    kernel = kRuns;
+
+    if( nchans <= 8 && SIMD::level() >= SIMD::SSE41 ) {
+
+        // Byte map: word (t*nkeep + k) <- word (t*nchans + keep[k])
+
+        tpv = 8 / nchans;
+        memset( shuf, 0x80, sizeof(shuf) );
+
+        for( int t = 0; t < tpv; ++t ) {
+
+            for( int k = 0; k < nkeep; ++k ) {
+
+                int o = 2 * (t*nkeep + k),
+                    i = 2 * (t*nchans + keep[k]);
+
+                shuf[o]     = char(i);
+                shuf[o + 1] = char(i + 1);
+            }
+        }
+
+        kernel = kShuffle;
+    }
+
+    if( !okKernel() )
+        kernel = kIndex;
+}
+
+
+// Work through a bounce buffer in place: (dst) can then never
+// pass unread (src), whatever the kernel's store width.
 //
-// In-place operation (dst == src) is allowed.
+void Gather::apply( qint16 *dst, const qint16 *src, qint64 ntpts ) const
+{
+    if( !nkeep )
+        return;
+
+    if( dst != src ) {
+        gather( dst, src, ntpts, kernel );
+        return;
+    }
+
+    std::vector<qint16> tmp( qMin( ntpts, qint64(GATHERBLK) ) * nkeep );
+
+    for( qint64 it = 0; it < ntpts; it += GATHERBLK ) {
+
+        qint64  nt = qMin( qint64(GATHERBLK), ntpts - it );
+
+        gather( &tmp[0], src + it*nchans, nt, kernel );
+        memcpy( dst + it*nkeep, &tmp[0], nt * nkeep * sizeof(qint16) );
+    }
+}
+
+
+// (dst) and (src) don't overlap.
 //
-// Return count of resulting dst timepoints.
+void Gather::gather(
+    qint16          *dst,
+    const qint16    *src,
+    qint64          ntpts,
+    int             k ) const
+{
+    if( k == kIndex ) {
+
+        const uint  *K = &keep[0];
+
+        for( qint64 it = 0; it < ntpts; ++it, src += nchans ) {
+
+            for( int ik = 0; ik < nkeep; ++ik )
+                *dst++ = src[K[ik]];
+        }
+
+        return;
+    }
+
+    qint64  done = 0;
+
+    if( k == kShuffle ) {
+
+        done = SIMD::level() >= SIMD::AVX2 ?
+                SIMD::gatherAVX2( dst, src, ntpts, nchans, nkeep, tpv, shuf ) :
+                SIMD::gatherSSSE3( dst, src, ntpts, nchans, nkeep, tpv, shuf );
+    }
+
+    gatherRuns( dst + done*nkeep, src + done*nchans, ntpts - done );
+}
+
+
+// Runs of up to 8 words move as one 16-byte copy, whose excess
+// the next run (or timepoint) overwrites. Near the buffer ends,
+// where that would read or write past them, runs copy exactly.
 //
-uint Subset::downsample(
-    vec_i16         &dst,
-    vec_i16         &src,
-    int             nchans,
-    int             dnsmp )
+void Gather::gatherRuns( qint16 *dst, const qint16 *src, qint64 ntpts ) const
 {
-    int ntpts = int(src.size()) / nchans;
+    int         nr      = run0.size();
+    const uint  *R0     = &run0[0],
+                *RN     = &runN[0];
+    qint64      nw      = ntpts * nchans,
+                nwo     = ntpts * nkeep,
+                rmax    = *std::max_element( run0.begin(), run0.end() ),
+                nfast   = 0;
 
-    if( dnsmp <= 1 ) {
+    // Timepoints whose 16-byte copies all stay in bounds
 
-        if( &dst != &src )
-            dst = src;
+    if( nw >= rmax + 8 && nwo >= nkeep + 8 ) {
 
-        return ntpts;
+        nfast = qMin( (nw - rmax - 8) / nchans,
+                      (nwo - nkeep - 8) / nkeep ) + 1;
+        nfast = qMin( nfast, ntpts );
     }
 
-    uint    dtpts = (ntpts + dnsmp - 1) / dnsmp;
+    for( qint64 it = 0; it < ntpts; ++it, src += nchans ) {
 
-    if( &dst != &src )
-        dst.resize( dtpts * nchans );
+        bool    fast = it < nfast;
+
+        for( int ir = 0; ir < nr; ++ir ) {
+
+            int n = RN[ir];
+
+            if( fast && n <= 8 )
+                memcpy( dst, &src[R0[ir]], 16 );
+            else
+                memcpy( dst, &src[R0[ir]], n * sizeof(qint16) );
+
+            dst += n;
+        }
+    }
+}
+
+
+// selfCheck() once per channel layout; Subset::subset() and
+// subsetBlock() make a Gather on every call.
+//
+bool Gather::okKernel() const
+{
+    std::vector<uint>   key( keep );
+
+    key.push_back( nchans );
 
-    qint16              *D = &dst[0],
-                        *S = &src[0];
+    {
+        QMutexLocker    ml( &checkMutex );
+
+        std::map<std::vector<uint>, bool>::const_iterator   it =
+            checked.find( key );
+
+        if( it != checked.end() )
+            return it->second;
+    }
+
+    bool    ok = selfCheck();
+
+    QMutexLocker    ml( &checkMutex );
+
+    if( checked.size() >= GATHERCHKS )
+        checked.clear();
+
+    checked[key] = ok;
+
+    return ok;
+}
+
+
+// Differential check of the chosen kernel against kIndex, over
+// enough timepoints to exercise vector bodies and scalar tails,
+// both out of place and in place.
+//
+bool Gather::selfCheck() const
+{
+    if( kernel == kIndex )
+        return true;
+
+    for( qint64 nt = 1; nt <= 67; nt += 11 ) {
+
+        vec_i16 src( nt * nchans ),
+                ref( nt * nkeep ),
+                out( nt * nkeep );
+
+        for( int i = 0, n = src.size(); i < n; ++i )
+            src[i] = qint16(i * 40503 + 12345);
+
+        gather( &ref[0], &src[0], nt, kIndex );
+        apply( &out[0], &src[0], nt );
+
+        if( out != ref )
+            return false;
+
+        apply( &src[0], &src[0], nt );
+        src.resize( nt * nkeep );
+
+        if( src != ref )
+            return false;
+    }
+
+    return true;
+}
+
+/* ---------------------------------------------------------------- */
+/* Bin workers ---------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#define BINBYTES    (1024*1024)     // src bytes per thread claim
+#define MEANMAXSMP  65536           // int32 sums can't overflow
+
+// Downsample the (ntpts) src timepoints at (S), in bins of
+// (dnsmp), the last maybe partial, into (D). In-place use,
+// (D) at or before (S), is allowed.
+//
+typedef void (*BinFun)(
+    qint16          *D,
+    const qint16    *S,
+    int             nchans,
+    int             dnsmp,
+    qint64          ntpts );
+
+
+// Mean, summed as double; any (dnsmp).
+//
+static void binMeanDbl(
+    qint16          *D,
+    const qint16    *S,
+    int             nchans,
+    int             dnsmp,
+    qint64          ntpts )
+{
     std::vector<double> sum( nchans );
 
-    for( int it = 0; it < ntpts; it += dnsmp, D += nchans ) {
+    for( qint64 it = 0; it < ntpts; it += dnsmp, D += nchans ) {
 
-        int ns = std::min( ntpts - it, dnsmp );
+        int ns = int(qMin( ntpts - it, qint64(dnsmp) ));
 
         memset( &sum[0], 0, nchans*sizeof(double) );
 
@@ -483,31 +719,221 @@ uint Subset::downsample(
         for( int ic = 0; ic < nchans; ++ic )
             D[ic] = qint16(sum[ic] / ns);
     }
+}
 
-    if( &dst == &src )
-        dst.resize( dtpts * nchans );
 
-    return dtpts;
+// Mean, summed as int32; (dnsmp) <= MEANMAXSMP. Sums are exact
+// either way, so results match binMeanDbl().
+//
+static void binMeanInt(
+    qint16          *D,
+    const qint16    *S,
+    int             nchans,
+    int             dnsmp,
+    qint64          ntpts )
+{
+    std::vector<qint32> acc( nchans );
+    int                 L = SIMD::level();
+
+    for( qint64 it = 0; it < ntpts; it += dnsmp, D += nchans ) {
+
+        int ns = int(qMin( ntpts - it, qint64(dnsmp) )),
+            ic = 0;
+
+        if( L >= SIMD::AVX2 )
+            ic = SIMD::binMeanAVX2( D, S, nchans, ns, &acc[0] );
+        else if( L >= SIMD::SSE41 )
+            ic = SIMD::binMeanSSE41( D, S, nchans, ns, &acc[0] );
+
+        for( ; ic < nchans; ++ic ) {
+
+            const qint16    *s      = &S[ic];
+            qint32          sum     = 0;
+
+            for( int is = 0; is < ns; ++is, s += nchans )
+                sum += *s;
+
+            D[ic] = qint16(double(sum) / ns);
+        }
+
+        S += qint64(ns) * nchans;
+    }
+}
+
+
+// Largest amplitude: bin min and max, then the one of larger
+// magnitude, max on ties.
+//
+static void binPeak(
+    qint16          *D,
+    const qint16    *S,
+    int             nchans,
+    int             dnsmp,
+    qint64          ntpts )
+{
+    vec_i16 lo( nchans ),
+            hi( nchans );
+    int     L = SIMD::level();
+
+    for( qint64 it = 0; it < ntpts; it += dnsmp, D += nchans ) {
+
+        int ns = int(qMin( ntpts - it, qint64(dnsmp) )),
+            ic = 0;
+
+        if( L >= SIMD::AVX2 )
+            ic = SIMD::binPeakAVX2( D, S, nchans, ns, &lo[0], &hi[0] );
+        else if( L >= SIMD::SSE41 )
+            ic = SIMD::binPeakSSE41( D, S, nchans, ns, &lo[0], &hi[0] );
+
+        for( ; ic < nchans; ++ic ) {
+
+            const qint16    *s      = &S[ic];
+            int             bMin    = *s,
+                            bMax    = *s;
+
+            for( int is = 1; is < ns; ++is ) {
+
+                s    += nchans;
+                bMin  = std::min( bMin, int(*s) );
+                bMax  = std::max( bMax, int(*s) );
+            }
+
+            D[ic] = (abs( bMax ) >= abs( bMin ) ? bMax : bMin);
+        }
+
+        S += qint64(ns) * nchans;
+    }
+}
+
+
+// Worker for runBins(): claims blocks of (blkbins) whole bins.
+//
+class BinThread : public QThread
+{
+private:
+    BinFun                  fun;
+    qint16                  *D;
+    const qint16            *S;
+    QAtomicInteger<qint64>  &next;
+    qint64                  ntpts;
+    int                     nchans,
+                            dnsmp,
+                            blkbins;
+
+public:
+    BinThread(
+        BinFun                  fun,
+        qint16                  *D,
+        const qint16            *S,
+        QAtomicInteger<qint64>  &next,
+        int                     nchans,
+        int                     dnsmp,
+        qint64                  ntpts,
+        int                     blkbins )
+    :   fun(fun), D(D), S(S), next(next), ntpts(ntpts),
+        nchans(nchans), dnsmp(dnsmp), blkbins(blkbins)      {}
+
+protected:
+    virtual void run();
+};
+
+
+void BinThread::run()
+{
+    qint64  nbin = (ntpts + dnsmp - 1) / dnsmp;
+
+    for(;;) {
+
+        qint64  b0 = next.fetchAndAddOrdered( 1 ) * blkbins;
+
+        if( b0 >= nbin )
+            break;
+
+        qint64  t0 = b0 * dnsmp;
+
+        fun( D + b0 * nchans, S + t0 * nchans, nchans, dnsmp,
+            qMin( ntpts - t0, qint64(blkbins) * dnsmp ) );
+    }
+}
+
+
+// Apply (fun) to all of (src), giving (dtpts) in (dst).
+//
+// With (nthd) > 1, threads take blocks of bins. In place, one
+// thread's output could overwrite input another hasn't read,
+// so then the output goes to a temporary, swapped in after.
+//
+static void runBins(
+    BinFun          fun,
+    vec_i16         &dst,
+    vec_i16         &src,
+    int             nchans,
+    int             dnsmp,
+    qint64          ntpts,
+    qint64          dtpts,
+    int             nthd )
+{
+    if( nthd <= 1 || dtpts < 2 ) {
+
+        if( &dst != &src )
+            dst.resize( dtpts * nchans );
+
+        if( ntpts )
+            fun( &dst[0], &src[0], nchans, dnsmp, ntpts );
+
+        if( &dst == &src )
+            dst.resize( dtpts * nchans );
+
+        return;
+    }
+
+    vec_i16                 tmp;
+    vec_i16                 &out = (&dst == &src ? tmp : dst);
+    QAtomicInteger<qint64>  next( 0 );
+    std::vector<BinThread*> vT;
+    int                     blkbins = qMax( qint64(1),
+                                BINBYTES / (qint64(dnsmp) * nchans * 2) );
+
+    out.resize( dtpts * nchans );
+
+    for( int i = 0; i < nthd; ++i ) {
+        vT.push_back(
+            new BinThread( fun, &out[0], &src[0], next,
+                nchans, dnsmp, ntpts, blkbins ) );
+        vT[i]->start();
+    }
+
+    for( int i = 0; i < nthd; ++i ) {
+        vT[i]->wait();
+        delete vT[i];
+    }
+
+    if( &dst == &src )
+        dst.swap( tmp );
 }
 
 /* ---------------------------------------------------------------- */
-/* downsampleNeural ----------------------------------------------- */
+/* downsample ----------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-// All src channels are downsampled by taking largest amplitude
-// value from each bin.
+// All src channels are downsampled/averaged.
 //
 // In-place operation (dst == src) is allowed.
 //
+// Sums are int32, vectorized if the CPU allows, for (dnsmp)
+// up to MEANMAXSMP. With (nthd) > 1, bins are split among
+// that many threads.
+//
 // Return count of resulting dst timepoints.
 //
-uint Subset::downsampleNeural(
+qint64 Subset::downsample(
     vec_i16         &dst,
     vec_i16         &src,
     int             nchans,
-    int             dnsmp )
+    int             dnsmp,
+    int             nthd )
 {
-    int ntpts = int(src.size()) / nchans;
+    qint64  ntpts = qint64(src.size()) / nchans;
 
     if( dnsmp <= 1 ) {
 
@@ -517,48 +943,49 @@ uint Subset::downsampleNeural(
         return ntpts;
     }
 
-    uint    dtpts = (ntpts + dnsmp - 1) / dnsmp;
-
-    if( &dst != &src )
-        dst.resize( dtpts * nchans );
-
-    qint16  *D = &dst[0],
-            *S = &src[0];
-    vec_i16 bMin( nchans ),
-            bMax( nchans );
+    qint64  dtpts = (ntpts + dnsmp - 1) / dnsmp;
 
-    for( int it = 0; it < ntpts; it += dnsmp, D += nchans ) {
+    runBins(
+        dnsmp <= MEANMAXSMP ? binMeanInt : binMeanDbl,
+        dst, src, nchans, dnsmp, ntpts, dtpts, nthd );
 
-        int ns = std::min( ntpts - it, dnsmp );
-
-        memcpy( &bMin[0], S, nchans*sizeof(qint16) );
-        memcpy( &bMax[0], S, nchans*sizeof(qint16) );
-        S += nchans;
-
-        for( int is = 1; is < ns; ++is, S += nchans ) {
+    return dtpts;
+}
 
-            for( int ic = 0; ic < nchans; ++ic ) {
+/* ---------------------------------------------------------------- */
+/* downsampleNeural ----------------------------------------------- */
+/* ---------------------------------------------------------------- */
 
-                int val = S[ic];
+// All src channels are downsampled by taking largest amplitude
+// value from each bin.
+//
+// In-place operation (dst == src) is allowed.
+//
+// Min/max are packed and branch-free if the CPU allows. With
+// (nthd) > 1, bins are split among that many threads.
+//
+// Return count of resulting dst timepoints.
+//
+qint64 Subset::downsampleNeural(
+    vec_i16         &dst,
+    vec_i16         &src,
+    int             nchans,
+    int             dnsmp,
+    int             nthd )
+{
+    qint64  ntpts = qint64(src.size()) / nchans;
 
-                if( val <= bMin[ic] )
-                    bMin[ic] = val;
-                else if( val > bMax[ic] )
-                    bMax[ic] = val;
-            }
-        }
+    if( dnsmp <= 1 ) {
 
-        for( int ic = 0; ic < nchans; ++ic ) {
+        if( &dst != &src )
+            dst = src;
 
-            if( abs( bMax[ic] ) >= abs( bMin[ic] ) )
-                D[ic] = bMax[ic];
-            else
-                D[ic] = bMin[ic];
-        }
+        return ntpts;
     }
 
-    if( &dst == &src )
-        dst.resize( dtpts * nchans );
+    qint64  dtpts = (ntpts + dnsmp - 1) / dnsmp;
+
+    runBins( binPeak, dst, src, nchans, dnsmp, ntpts, dtpts, nthd );
 
     return dtpts;
 }
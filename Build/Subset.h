@@ -7,6 +7,8 @@
 #include <QString>
 #include <QVector>
 
+#include <vector>
+
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -48,17 +50,75 @@ public:
         int                 cLim,
         int                 nchans );
 
-    static uint downsample(
+    static qint64 downsample(
         vec_i16         &dst,
         vec_i16         &src,
         int             nchans,
-        int             dnsmp );
+        int             dnsmp,
+        int             nthd = 1 );
 
-    static uint downsampleNeural(
+    static qint64 downsampleNeural(
         vec_i16         &dst,
         vec_i16         &src,
         int             nchans,
-        int             dnsmp );
+        int             dnsmp,
+        int             nthd = 1 );
+};
+
+
+// Compiled form of Subset::subset() for repeated use. Built once
+// per channel list, then applied to any number of timepoints.
+//
+// Kernels:
+// - kIndex:    one word at a time, as Subset::subset() was.
+// - kRuns:     runs of adjacent kept channels, each moved as a
+//              block; short runs as one whole 16-byte move.
+// - kShuffle:  files of up to 8 channels; whole timepoints per
+//              vector, packed by a byte shuffle (SIMD).
+//
+// make() picks the fastest the CPU supports, then checks it
+// against kIndex, once per channel layout; any difference falls
+// back to kIndex.
+//
+class Gather
+{
+public:
+    enum Kernel {
+        kIndex,
+        kRuns,
+        kShuffle
+    };
+
+public:
+    std::vector<uint>   keep,       // src channel of each dst channel
+                        run0,       // first src channel of run
+                        runN;       // channels in run
+    char                shuf[16];   // kShuffle byte map
+    int                 nchans,     // src channels/timepoint
+                        nkeep,      // dst channels/timepoint
+                        tpv,        // kShuffle timepoints/vector
+                        kernel;
+
+public:
+    Gather() : nchans(0), nkeep(0), tpv(0), kernel(kIndex) {}
+
+    // (iKeep) all < (nchans).
+    void make( const QVector<uint> &iKeep, int nchans );
+
+    bool isAll() const  {return nkeep >= nchans;}
+
+    // In-place operation (dst == src) is allowed.
+    void apply( qint16 *dst, const qint16 *src, qint64 ntpts ) const;
+
+private:
+    void gather(
+        qint16          *dst,
+        const qint16    *src,
+        qint64          ntpts,
+        int             k ) const;
+    void gatherRuns( qint16 *dst, const qint16 *src, qint64 ntpts ) const;
+    bool okKernel() const;
+    bool selfCheck() const;
 };
 
 #endif  // SUBSET_H
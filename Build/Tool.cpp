@@ -2,6 +2,9 @@
 #include "Tool.h"
 #include "CGBL.h"
 #include "Util.h"
+#include "Scaler.h"
+#include "Cbin.h"
+#include "Crc.h"
 #include "Subset.h"
 
 #ifdef HAVE_NIDAQmx
@@ -10,7 +13,9 @@
 #pragma message("*** Message to self: Building simulated NI-DAQ version ***")
 #endif
 
+#include <QCryptographicHash>
 #include <QDirIterator>
+#include <QThread>
 
 
 /* ---------------------------------------------------------------- */
@@ -275,212 +280,6 @@ fail:
 }
 #endif
 
-/* ---------------------------------------------------------------- */
-/* Coeff ---------------------------------------------------------- */
-/* ---------------------------------------------------------------- */
-
-void Coeff::get( QSettings &S, const QString &grpdev )
-{
-    S.beginGroup( grpdev );
-
-    int nai = S.value( "nai", 0 ).toInt();
-
-    V.resize( nai );
-
-    for( int ic = 0; ic < nai; ++ic ) {
-
-        std::vector<double> &C = V[ic];
-
-        QStringList sl = S.value( QString("ai%1").arg( ic ) ).toStringList();
-        ncof = sl.size();
-
-        for( int k = 0; k < ncof; ++k )
-            C.push_back( sl.at( k ).toDouble() );
-    }
-
-    S.endGroup();
-}
-
-/* ---------------------------------------------------------------- */
-/* Plan ----------------------------------------------------------- */
-/* ---------------------------------------------------------------- */
-
-void Plan::make( const KVParams &kvp )
-{
-    std::vector<bool>   vK1;  // true if K1
-    std::vector<uint>   vai;  // physical channel
-    QVector<uint>       vi;
-    int                 kmux = kvp["niMuxFactor"].toInt();
-    int                 nv;
-    bool                dual = kvp["niDualDevMode"].toBool();
-
-    V2I = 32768 / kvp["niAiRangeMax"].toDouble();
-    nC  = kvp["nSavedChans"].toInt();
-
-// First fill {vK1, vai} with acquired NI channels
-
-// MN
-
-    QString chnstr = kvp["niMNChans1"].toString();
-
-    if( !chnstr.isEmpty() ) {
-
-        Subset::rngStr2Vec( vi, chnstr );
-
-        for( int ic = 0, nc = vi.size(); ic < nc; ++ic ) {
-
-            uint    ai = vi[ic];
-
-            for( int j = 0; j < kmux; ++j ) {
-                vK1.push_back( true );
-                vai.push_back( ai );
-            }
-        }
-    }
-
-    if( dual ) {
-
-        chnstr = kvp["niMNChans2"].toString();
-
-        if( !chnstr.isEmpty() ) {
-
-            Subset::rngStr2Vec( vi, chnstr );
-
-            for( int ic = 0, nc = vi.size(); ic < nc; ++ic ) {
-
-                uint    ai = vi[ic];
-
-                for( int j = 0; j < kmux; ++j ) {
-                    vK1.push_back( false );
-                    vai.push_back( ai );
-                }
-            }
-        }
-    }
-
-// MA
-
-    chnstr = kvp["niMAChans1"].toString();
-
-    if( !chnstr.isEmpty() ) {
-
-        Subset::rngStr2Vec( vi, chnstr );
-
-        for( int ic = 0, nc = vi.size(); ic < nc; ++ic ) {
-
-            uint    ai = vi[ic];
-
-            for( int j = 0; j < kmux; ++j ) {
-                vK1.push_back( true );
-                vai.push_back( ai );
-            }
-        }
-    }
-
-    if( dual ) {
-
-        chnstr = kvp["niMAChans2"].toString();
-
-        if( !chnstr.isEmpty() ) {
-
-            Subset::rngStr2Vec( vi, chnstr );
-
-            for( int ic = 0, nc = vi.size(); ic < nc; ++ic ) {
-
-                uint    ai = vi[ic];
-
-                for( int j = 0; j < kmux; ++j ) {
-                    vK1.push_back( false );
-                    vai.push_back( ai );
-                }
-            }
-        }
-    }
-
-// XA
-
-    chnstr = kvp["niXAChans1"].toString();
-
-    if( !chnstr.isEmpty() ) {
-
-        Subset::rngStr2Vec( vi, chnstr );
-
-        for( int ic = 0, nc = vi.size(); ic < nc; ++ic ) {
-
-            vK1.push_back( true );
-            vai.push_back( vi[ic] );
-        }
-    }
-
-    if( dual ) {
-
-        chnstr = kvp["niXAChans2"].toString();
-
-        if( !chnstr.isEmpty() ) {
-
-            Subset::rngStr2Vec( vi, chnstr );
-
-            for( int ic = 0, nc = vi.size(); ic < nc; ++ic ) {
-
-                vK1.push_back( false );
-                vai.push_back( vi[ic] );
-            }
-        }
-    }
-
-// Next copy only saved channels to plan
-
-    QBitArray   b;
-
-    chnstr  = kvp["snsSaveChanSubset"].toString();
-    nv      = vai.size();
-
-    if( Subset::isAllChansStr( chnstr ) )
-        Subset::defaultBits( b, nv );
-    else
-        Subset::rngStr2Bits( b, chnstr );
-
-    for( int ib = 0; ib < nv; ++ib ) {
-
-        if( b.testBit( ib ) ) {
-            ic2K1.push_back( vK1[ib] );
-            ic2ai.push_back( vai[ib] );
-        }
-    }
-
-    nai = ic2ai.size();
-}
-
-
-void Plan::apply( qint16 *d, int ntpts, const Coeff &K1, const Coeff &K2 ) const
-{
-    for( int it = 0; it < ntpts; ++it, d += nC ) {
-
-        for( int ic = 0; ic < nai; ++ic ) {
-
-            double          V = 0.0;
-            const double    *C;
-            int             ncof;
-
-            if( ic2K1[ic] ) {
-                C       = &K1.V[ic2ai[ic]][0];
-                ncof    = K1.ncof;
-            }
-            else {
-                C       = &K2.V[ic2ai[ic]][0];
-                ncof    = K2.ncof;
-            }
-
-            for( int k = ncof - 1; k > 0; --k ) {
-                V += C[k];
-                V *= d[ic];
-            }
-
-            d[ic] = qBound( SHRT_MIN, int(V2I * (V + C[0])), SHRT_MAX );
-        }
-    }
-}
-
 /* ---------------------------------------------------------------- */
 /* Tool ----------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -490,10 +289,16 @@ void Tool::entrypoint()
     if( GBL.create && !createCal() )
         return;
 
-    if( !GBL.apply )
-        return;
+    if( GBL.apply ) {
 
-    apply();
+        if( !GBL.stream.isEmpty() )
+            applyStream();
+        else
+            apply();
+    }
+
+    if( !GBL.verify_crc.isEmpty() )
+        verifyCrc();
 }
 
 
@@ -614,23 +419,218 @@ void Tool::apply()
     GBL.src_dir += "/";
     GBL.dst_dir += "/";
 
-    QSettings   S( GBL.calFile(), QSettings::IniFormat );
+    QSettings   S( GBL.calFile(), QSettings::IniFormat ),
+                prog( progFile(), QSettings::IniFormat );
+    QStringList failed;
+    int         nscaled     = 0,
+                nskipped    = 0;
 
     foreach( const QString &s, sl ) {
 
         Coeff       K1, K2;
         KVParams    kvp;
+        QString     sbin = meta2bin( s );
+
+        if( !GBL.in_place && do1_is_finished( prog, s ) ) {
+
+            Log() << QString("Skipping (Finished in earlier run) '%1'.")
+                        .arg( s );
+            ++nskipped;
+            continue;
+        }
 
         if( do1_ok_meta( kvp, s ) &&
-            do1_ok_coef( K1, K2, S, kvp, s ) &&
-            do1_update_meta( s, kvp ) ) {
+            do1_ok_coef( K1, K2, S, kvp, s ) ) {
 
             Plan    P;
-            P.make( kvp );
+            P.make( kvp, K1, K2 );
+            P.compile( Plan::Kernel(Plan::name2Kernel( GBL.kernel )) );
+
+            // Stamp meta only once bin is complete
+
+            failWhy.clear();
+
+            bool    ok = GBL.compress ?
+                            do1_compress( s, P, kvp ) :
+                            do1_scale( s, P, kvp, prog );
+
+            if( ok && do1_update_meta( s, kvp ) ) {
+
+                ++nscaled;
+
+                if( GBL.in_place )
+                    QFile::remove( journal( s ) );
+                else {
+                    do1_set_prog_key( prog, s );
+                    prog.remove( sbin + "/failed" );
+                    prog.setValue( sbin + "/finished", true );
+                    prog.sync();
+                }
+            }
+            else {
+
+                failed.append( QString("'%1' (%2)")
+                    .arg( s ).arg( failWhy.isEmpty() ? "error" : failWhy ) );
+
+                // Output unusable; don't resume from it
+
+                if( !failWhy.isEmpty() && !GBL.in_place ) {
+                    prog.setValue( sbin + "/failed", failWhy );
+                    prog.remove( sbin + "/doneBytes" );
+                    prog.sync();
+                }
+            }
+        }
+        else
+            ++nskipped;
+    }
+
+    Log() << QString("Summary: %1 scaled, %2 skipped, %3 failed.")
+                .arg( nscaled ).arg( nskipped ).arg( failed.size() );
+
+    foreach( const QString &f, failed )
+        Log() << QString("    FAILED %1").arg( f );
+}
+
+
+// Scale stdin to stdout, qualified and planned by the
+// metafile named in -stream=.
+//
+void Tool::applyStream()
+{
+    QSettings   S( GBL.calFile(), QSettings::IniFormat );
+    QString     s = GBL.stream;
+    Coeff       K1, K2;
+    KVParams    kvp;
+
+    if( !QFileInfo( GBL.calFile() ).exists() ) {
+        Log() << QString("Error: File not found <%1>.").arg( GBL.calFile() );
+        return;
+    }
+
+    if( !kvp.fromMetaFile( s ) ) {
+        Log() << QString("Meta file is corrupt '%1'.").arg( s );
+        return;
+    }
+
+    if( !do1_ok_version( kvp, s ) || !do1_ok_coef( K1, K2, S, kvp, s ) )
+        return;
+
+    Plan    P;
+    P.make( kvp, K1, K2 );
+    P.compile( Plan::Kernel(Plan::name2Kernel( GBL.kernel )) );
+
+    QFile   fa, fb;
+
+    prepStdPipe( 0 );
+    prepStdPipe( 1 );
+
+    if( !fa.open( 0, QIODevice::ReadOnly | QIODevice::Unbuffered )
+        || !fb.open( 1, QIODevice::WriteOnly | QIODevice::Unbuffered ) ) {
+
+        Log() << "Error opening stdin/stdout.";
+        return;
+    }
+
+    Scaler  Sc( P, fa, fb );
+    double  t0 = getTime();
+
+    if( !Sc.streamed() ) {
+        Log() << "Error scaling stream.";
+        return;
+    }
 
-            do1_scale( s, P, K1, K2 );
+    t0 = getTime() - t0;
+
+    Sc.logPipeStats();
+
+    Log() << QString("Scaled stream (%1 MB, %2 MB/s).")
+                .arg( Sc.bytes() / (1024*1024) )
+                .arg( t0 > 0 ? Sc.bytes() / (1024*1024 * t0) : 0.0, 0, 'f', 1 );
+}
+
+
+// Check each bin in -verify_crc dir against its .crc
+// sidecar, chunks in parallel.
+//
+void Tool::verifyCrc()
+{
+    QString     dir = GBL.verify_crc + "/";
+    QStringList failed;
+    int         nok = 0;
+
+    if( !QFileInfo( dir ).exists() ) {
+        Log() << QString("Error: Dir not found <%1>.").arg( dir );
+        return;
+    }
+
+    QDirIterator    it( dir, QStringList() << "*.crc", QDir::Files );
+
+    while( it.hasNext() ) {
+
+        it.next();
+
+        QString             scrc    = it.fileName(),
+                            sbin    = QString(scrc).replace(
+                                        QRegExp("crc$"), "bin" );
+        ChunkCrc            C;
+        std::vector<qint64> bad;
+        double              t0      = getTime();
+
+        if( !C.fromFile( dir + scrc ) ) {
+            Log() << QString("CRC file is corrupt '%1'.").arg( scrc );
+            failed.append( QString("'%1' (corrupt .crc)").arg( sbin ) );
+            continue;
+        }
+
+        if( C.complete && QFileInfo( dir + sbin ).size() != C.nbytes ) {
+            Log() << QString("Size mismatch (crc %1, bin %2) '%3'.")
+                        .arg( C.nbytes )
+                        .arg( QFileInfo( dir + sbin ).size() )
+                        .arg( sbin );
+            failed.append( QString("'%1' (size mismatch)").arg( sbin ) );
+            continue;
+        }
+
+        if( !C.verify( dir + sbin, workers(), bad ) ) {
+            Log() << QString("Error reading binfile '%1'.").arg( sbin );
+            failed.append( QString("'%1' (read error)").arg( sbin ) );
+            continue;
+        }
+
+        t0 = getTime() - t0;
+
+        if( !bad.empty() ) {
+
+            QStringList sl;
+
+            for( int i = 0, n = bad.size(); i < n && i < 16; ++i )
+                sl.append( QString::number( bad[i] ) );
+
+            if( bad.size() > 16 )
+                sl.append( "..." );
+
+            Log() << QString("CRC mismatch '%1': %2 of %3 chunks bad (%4).")
+                        .arg( sbin ).arg( bad.size() ).arg( C.crcs.size() )
+                        .arg( sl.join( ", " ) );
+            failed.append( QString("'%1' (%2 bad chunks)")
+                            .arg( sbin ).arg( bad.size() ) );
+            continue;
         }
+
+        Log() << QString("Verified '%1'%2 (%3 chunks, %4 MB/s).")
+                    .arg( sbin )
+                    .arg( C.complete ? "" : " to checkpoint" )
+                    .arg( C.crcs.size() )
+                    .arg( t0 > 0 ? C.nbytes / (1024*1024 * t0) : 0.0, 0, 'f', 1 );
+        ++nok;
     }
+
+    Log() << QString("Summary: %1 verified, %2 failed.")
+                .arg( nok ).arg( failed.size() );
+
+    foreach( const QString &f, failed )
+        Log() << QString("    FAILED %1").arg( f );
 }
 
 
@@ -692,8 +692,17 @@ bool Tool::do1_ok_meta( KVParams &kvp, const QString &s )
     QString sbin = meta2bin( s );
 
     if( !QFileInfo( GBL.src_dir + sbin ).exists() ) {
-        Log() << QString("Binary file not found '%1'.").arg( sbin );
-        return false;
+
+        if( !srcIsCbin( s ) ) {
+            Log() << QString("Binary file not found '%1'.").arg( sbin );
+            return false;
+        }
+
+        if( GBL.in_place ) {
+            Log() << QString("Skipping (Can't scale .cbin in place) '%1'.")
+                        .arg( s );
+            return false;
+        }
     }
 
 // Open
@@ -703,6 +712,26 @@ bool Tool::do1_ok_meta( KVParams &kvp, const QString &s )
         return false;
     }
 
+    if( !do1_ok_version( kvp, s ) )
+        return false;
+
+// Half-scaled by an interrupted in-place run; scaling it
+// again as raw data would double-scale the finished chunks
+
+    if( !GBL.in_place && QFileInfo( journal( s ) ).exists() ) {
+        Log() << QString(
+                "Skipping (Interrupted in-place run, journal '%1';"
+                " rerun with -in_place to finish) '%2'.")
+                .arg( sbin + ".journal" ).arg( s );
+        return false;
+    }
+
+    return true;
+}
+
+
+bool Tool::do1_ok_version( const KVParams &kvp, const QString &s )
+{
 // Qualify
 
     if( kvp["appVersion"].toString() >= "20220101" ) {
@@ -714,6 +743,12 @@ bool Tool::do1_ok_meta( KVParams &kvp, const QString &s )
     if( kvp.contains( "NIScaler" ) ) {
         Log() << QString("Skipping (Already scaled [%1]) '%2'.")
                     .arg( kvp["NIScaler"].toString() ).arg( s );
+
+        // Crashed after stamping meta; bin is complete
+
+        if( GBL.in_place )
+            QFile::remove( journal( s ) );
+
         return false;
     }
 
@@ -781,47 +816,750 @@ bool Tool::do1_update_meta( const QString &s, KVParams &kvp )
 }
 
 
-void Tool::do1_scale(
+// Scaled output is hashed as it's written, for the meta's
+// fileSHA1; output from an earlier run is read back to hash.
+//
+bool Tool::do1_scale(
     const QString   &s,
     const Plan      &P,
-    const Coeff     &K1,
-    const Coeff     &K2 )
+    KVParams        &kvp,
+    QSettings       &prog )
 {
-#define BUFBYTES    128*1024
+    if( GBL.in_place )
+        return do1_scale_in_place( s, P, kvp );
 
-    QString sbin = meta2bin( s );
-    QFile   fa( GBL.src_dir + sbin );
-    QFile   fb( GBL.dst_dir + sbin );
+    QString                 sbin = meta2bin( s ),
+                            ssrc = srcIsCbin( s ) ? meta2ext( s, "cbin" ) : sbin;
+    QFile                   fa( GBL.src_dir + ssrc );
+    QFile                   fb( GBL.dst_dir + sbin );
+    QIODevice::OpenMode     amode = QIODevice::ReadOnly,
+                            bmode = QIODevice::WriteOnly,
+                            xtra  = QIODevice::NotOpen;
+    Cbin                    Ci;
+    int                     eng   = Scaler::name2Engine( GBL.io );
+    qint64                  done  = 0;
+
+// Compressed source is decoded by threads
+
+    if( ssrc != sbin ) {
+
+        if( !Ci.fromChFile( GBL.src_dir + meta2ext( s, "ch" ),
+                QFileInfo( GBL.src_dir + ssrc ).size() ) ) {
+
+            Log() << QString("Chunk file is corrupt '%1'.")
+                        .arg( meta2ext( s, "ch" ) );
+            return false;
+        }
+
+        eng = -1;
+    }
+
+// Direct reads need block aligned offsets
 
-    fa.open( QIODevice::ReadOnly );
-    fb.open( QIODevice::WriteOnly );
+    if( GBL.hasWindow() && eng == Scaler::eDirect ) {
+        Log() << "    Direct I/O can't start mid-file; using page cache.";
+        eng = Scaler::ePipe;
+    }
+
+// Checkpoint from earlier run?
 
-    std::vector<char>   buf( BUFBYTES );
+    if( do1_ok_prog_key( prog, s ) ) {
 
-    quint64 asmp    = fa.size() / (2 * P.nC),
-            bufsmp  = BUFBYTES / (2 * P.nC);
+        done = prog.value( sbin + "/doneBytes", 0 ).toLongLong();
 
-    while( asmp ) {
+        if( QFileInfo( GBL.dst_dir + sbin ).size() < done )
+            done = 0;
+    }
 
-        int smp = qMin( bufsmp, asmp );
+    if( eng == Scaler::eDirect || GBL.threads > 1 || eng < 0 )
+        xtra = QIODevice::Unbuffered;
 
-        fa.read( &buf[0], 2 * P.nC * smp );
+    if( done )
+        bmode = QIODevice::ReadWrite;
+    else if( eng == Scaler::eMmap )
+        bmode = QIODevice::ReadWrite | QIODevice::Truncate;
 
-        P.apply( (qint16*)&buf[0], smp, K1, K2 );
+    amode |= xtra;
+    bmode |= xtra;
 
-        fb.write( &buf[0], 2 * P.nC * smp );
+    if( eng == Scaler::eDirect
+        && !(openDirect( fa, amode ) && openDirect( fb, bmode )) ) {
 
-        asmp -= smp;
+        Log() << "    Direct I/O unavailable; using page cache.";
+        fa.close();
+        fb.close();
     }
-}
 
+    if( !fa.isOpen() && !fa.open( amode ) ) {
+        Log() << QString("Error opening binfile '%1'.").arg( sbin );
+        return false;
+    }
 
-QString Tool::meta2bin( const QString &meta )
+    if( !fb.isOpen() && !fb.open( bmode ) ) {
+        Log() << QString("Error creating binfile '%1'.").arg( sbin );
+        return false;
+    }
+
+// Scale by segments, recording each once it's on disk
+
+    Scaler              S( P, fa, fb );
+    Gather              G;
+    QCryptographicHash  H( QCryptographicHash::Sha1 ),
+                        Hs( QCryptographicHash::Sha1 );
+    ChunkCrc            C;
+    QString             want,
+                        scrc    = GBL.dst_dir + meta2ext( s, "crc" );
+    bool                verify  = do1_want_sha1( want, kvp, s );
+
+    if( eng < 0 && !S.setSource( Ci ) ) {
+        Log() << QString("Chunk file doesn't match meta '%1'.").arg( s );
+        return false;
+    }
+
+    if( !do1_window( S, kvp, s ) || !do1_chans( S, G, kvp, s ) )
+        return false;
+
+    // Output is resumed in output timepoints, src read in src's
+
+    qint64  seg     = S.segTpts(),
+            tstart  = qMin( done / S.outTpBytes(), S.tpts() );
+    double  t0      = getTime();
+
+    if( tstart ) {
+
+        Log() << QString("    Resuming '%1' at %2%.")
+                    .arg( sbin ).arg( 100 * tstart / S.tpts() );
+
+        if( verify && eng < 0 ) {
+            Log() << QString("    Can't verify resumed .cbin source '%1'.")
+                        .arg( ssrc );
+            verify = false;
+        }
+
+        if( !do1_hash_file( H, GBL.crc ? &C : 0,
+                GBL.dst_dir + sbin, 0, tstart * S.outTpBytes() ) ) {
+
+            Log() << QString("Error reading binfile '%1'.").arg( sbin );
+            return false;
+        }
+
+        if( GBL.crc && !do1_ok_crc_done( C, scrc, sbin ) ) {
+            H.reset();
+            C.reset();
+            tstart = 0;
+        }
+
+        if( tstart && verify
+            && !do1_hash_file( Hs, 0,
+                    GBL.src_dir + ssrc, 0, tstart * S.tpBytes() ) ) {
+
+            Log() << QString("Error reading binfile '%1'.").arg( ssrc );
+            return false;
+        }
+    }
+
+    // Sidecar of an earlier bin is stale
+
+    if( !tstart )
+        QFile::remove( scrc );
+
+    S.setHash( &H );
+
+    if( GBL.crc )
+        S.setCrc( &C );
+
+    if( verify )
+        S.setSrcHash( &Hs );
+
+    do1_set_prog_key( prog, s );
+
+    for( qint64 t = tstart; t < S.tpts(); t += seg ) {
+
+        qint64  t1 = qMin( t + seg, S.tpts() );
+
+        S.setRange( t, t1 );
+
+        if( !do1_run( S, eng ) || !syncFile( fb ) ) {
+            Log() << QString("Error scaling binfile '%1'.").arg( sbin );
+            return false;
+        }
+
+        if( GBL.crc && !C.toFile( scrc ) ) {
+            Log() << QString("Error writing CRC file '%1'.").arg( scrc );
+            return false;
+        }
+
+        prog.setValue( sbin + "/doneBytes", t1 * S.outTpBytes() );
+        prog.sync();
+    }
+
+    t0 = getTime() - t0;
+
+    // Src hash covers any trailing partial timepoint
+
+    if( verify ) {
+
+        if( eng >= 0
+            && !do1_hash_file( Hs, 0, GBL.src_dir + ssrc,
+                    S.bytes(), fa.size() - S.bytes() ) ) {
+
+            Log() << QString("Error reading binfile '%1'.").arg( ssrc );
+            return false;
+        }
+
+        if( !do1_ok_sha1( Hs, want, s ) )
+            return false;
+    }
+
+    if( GBL.crc ) {
+
+        C.finish();
+
+        if( !C.toFile( scrc ) ) {
+            Log() << QString("Error writing CRC file '%1'.").arg( scrc );
+            return false;
+        }
+    }
+
+    do1_set_hash( kvp, H, S.outBytes() );
+
+    if( eng == Scaler::ePipe && GBL.threads <= 1 )
+        S.logPipeStats();
+
+    Log() << QString("Scaled '%1' (%2 MB/s).")
+                .arg( sbin )
+                .arg( t0 > 0 ?
+                    (S.tpts() - tstart) * S.tpBytes() / (1024*1024 * t0)
+                    : 0.0, 0, 'f', 1 );
+
+    return true;
+}
+
+
+// Run selected engine over Scaler's current range.
+//
+bool Tool::do1_run( Scaler &S, int eng )
+{
+    if( S.cbinSource() )
+        return S.threaded( workers() );
+    else if( eng == Scaler::eDirect )
+        return S.direct( GBL.threads );
+    else if( GBL.threads > 1 )
+        return S.threaded( GBL.threads );
+    else if( eng == Scaler::eMmap )
+        return S.mapped();
+    else if( eng == Scaler::eUring )
+        return S.queued();
+    else if( eng == Scaler::ePipe )
+        return S.pipelined();
+
+    return S.serial();
+}
+
+
+// Scale src bin over itself; restartable via journal.
+//
+bool Tool::do1_scale_in_place( const QString &s, const Plan &P, KVParams &kvp )
+{
+    QString sbin = meta2bin( s );
+    QFile   fa( GBL.src_dir + sbin );
+
+    if( !fa.open( QIODevice::ReadWrite | QIODevice::Unbuffered ) ) {
+        Log() << QString("Error opening binfile '%1'.").arg( sbin );
+        return false;
+    }
+
+    Scaler              S( P, fa, fa );
+    QCryptographicHash  H( QCryptographicHash::Sha1 ),
+                        Hs( QCryptographicHash::Sha1 );
+    ChunkCrc            C;
+    QString             want,
+                        scrc    = GBL.src_dir + meta2ext( s, "crc" );
+    double              t0      = getTime();
+
+    // Verify before first overwrite; a bad src can't be restored
+
+    if( do1_want_sha1( want, kvp, s ) ) {
+
+        if( QFileInfo( journal( s ) ).exists() ) {
+            Log() << QString("    Can't verify resumed in-place '%1'.")
+                        .arg( sbin );
+        }
+        else if( !do1_hash_file( Hs, 0, GBL.src_dir + sbin, 0, fa.size() )
+            || !do1_ok_sha1( Hs, want, s ) ) {
+
+            return false;
+        }
+    }
+
+    // Sidecar of the unscaled bin is stale
+
+    QFile::remove( scrc );
+
+    S.setHash( &H );
+
+    if( GBL.crc )
+        S.setCrc( &C );
+
+    if( !S.inPlace( journal( s ) ) ) {
+        Log() << QString("Error scaling binfile in place '%1'.").arg( sbin );
+        return false;
+    }
+
+    if( GBL.crc ) {
+
+        C.finish();
+
+        if( !C.toFile( scrc ) ) {
+            Log() << QString("Error writing CRC file '%1'.").arg( scrc );
+            return false;
+        }
+    }
+
+    t0 = getTime() - t0;
+
+    do1_set_hash( kvp, H, S.bytes() );
+
+    Log() << QString("Scaled in place '%1' (%2 MB/s).")
+                .arg( sbin )
+                .arg( t0 > 0 ? S.bytes() / (1024*1024 * t0) : 0.0, 0, 'f', 1 );
+
+    return true;
+}
+
+
+// Scale src bin to dst as a .cbin/.ch pair, encoding chunks of
+// one second in parallel. Unlike do1_scale, there are no segment
+// checkpoints: an interrupted .cbin has no .ch, and is redone.
+//
+// A .cbin source keeps its chunk bounds and compression level.
+//
+bool Tool::do1_compress( const QString &s, const Plan &P, KVParams &kvp )
+{
+    QString sbin    = meta2bin( s ),
+            scbin   = meta2ext( s, "cbin" ),
+            ssrc    = srcIsCbin( s ) ? scbin : sbin;
+    QFile   fa( GBL.src_dir + ssrc ),
+            fb( GBL.dst_dir + scbin );
+    Cbin    Ci;
+
+    if( ssrc != sbin
+        && !Ci.fromChFile( GBL.src_dir + meta2ext( s, "ch" ),
+                QFileInfo( GBL.src_dir + ssrc ).size() ) ) {
+
+        Log() << QString("Chunk file is corrupt '%1'.")
+                    .arg( meta2ext( s, "ch" ) );
+        return false;
+    }
+
+    if( !fa.open( QIODevice::ReadOnly | QIODevice::Unbuffered ) ) {
+        Log() << QString("Error opening binfile '%1'.").arg( ssrc );
+        return false;
+    }
+
+    if( !fb.open( QIODevice::WriteOnly ) ) {
+        Log() << QString("Error creating binfile '%1'.").arg( scbin );
+        return false;
+    }
+
+    Scaler              S( P, fa, fb );
+    Gather              G;
+    Cbin                C;
+    QCryptographicHash  Hs( QCryptographicHash::Sha1 );
+    QString             want;
+    bool                verify = do1_want_sha1( want, kvp, s );
+    double              t0 = getTime();
+
+    if( verify )
+        S.setSrcHash( &Hs );
+
+    C.srate = kvp["niSampRate"].toDouble();
+
+    if( ssrc != sbin ) {
+
+        if( !S.setSource( Ci ) ) {
+            Log() << QString("Chunk file doesn't match meta '%1'.").arg( s );
+            return false;
+        }
+
+        C.level = Ci.level;
+    }
+
+    if( !do1_window( S, kvp, s ) || !do1_chans( S, G, kvp, s ) )
+        return false;
+
+    if( ssrc != sbin && !GBL.hasWindow() )
+        C.bounds = Ci.bounds;
+    else
+        C.setBounds( S.tpts(), qMax( qint64(1), qint64(C.srate) ) );
+
+    if( !S.compressed( workers(), C ) || !syncFile( fb ) ) {
+
+        Log() << QString("Error compressing binfile '%1'.").arg( sbin );
+        return false;
+    }
+
+    // Src hash covers any trailing partial timepoint
+
+    if( verify ) {
+
+        if( ssrc == sbin
+            && !do1_hash_file( Hs, 0, GBL.src_dir + ssrc,
+                    S.bytes(), fa.size() - S.bytes() ) ) {
+
+            Log() << QString("Error reading binfile '%1'.").arg( ssrc );
+            return false;
+        }
+
+        // No .ch: output stays incomplete
+
+        if( !do1_ok_sha1( Hs, want, s ) )
+            return false;
+    }
+
+    if( !C.toChFile( GBL.dst_dir + meta2ext( s, "ch" ) ) ) {
+        Log() << QString("Error writing chunk file for '%1'.").arg( scbin );
+        return false;
+    }
+
+    t0 = getTime() - t0;
+
+    // Meta describes the decoded bin
+
+    kvp["fileSHA1"]         = C.sha1u.toUpper();
+    kvp["fileSizeBytes"]    = S.outBytes();
+
+    Log() << QString("Compressed '%1' (%2 MB/s, ratio %3).")
+                .arg( sbin )
+                .arg( t0 > 0 ? S.bytes() / (1024*1024 * t0) : 0.0, 0, 'f', 1 )
+                .arg( C.offsets.back() ?
+                        double(S.outBytes()) / C.offsets.back() : 0.0, 0, 'f', 2 );
+
+    return true;
+}
+
+
+// Hash (bytes) of (bin) from (offset): output scaled in an
+// earlier run, or src not read by the engine. If (crc) is set,
+// it gets the bytes too.
+//
+// Return true if no errors.
+//
+bool Tool::do1_hash_file(
+    QCryptographicHash  &H,
+    ChunkCrc            *crc,
+    const QString       &bin,
+    qint64              offset,
+    qint64              bytes )
+{
+    QFile               f( bin );
+    std::vector<char>   buf( 4*1024*1024 );
+
+    if( !f.open( QIODevice::ReadOnly ) || !f.seek( offset ) )
+        return false;
+
+    while( bytes > 0 ) {
+
+        qint64  n = qMin( bytes, qint64(buf.size()) );
+
+        if( f.read( &buf[0], n ) != n )
+            return false;
+
+        H.addData( &buf[0], n );
+
+        if( crc )
+            crc->add( &buf[0], n );
+
+        bytes -= n;
+    }
+
+    return true;
+}
+
+
+// On resume, compare CRCs of the done part (C), just reread,
+// with the checkpoint sidecar (scrc).
+//
+// Return false if a done chunk has changed since.
+//
+bool Tool::do1_ok_crc_done(
+    const ChunkCrc  &C,
+    const QString   &scrc,
+    const QString   &sbin )
+{
+    ChunkCrc    Cold;
+
+    if( !Cold.fromFile( scrc ) || Cold.chunkBytes != C.chunkBytes ) {
+        Log() << QString("    No CRC checkpoint for '%1'; not checked.")
+                    .arg( sbin );
+        return true;
+    }
+
+    qint64  nchk    = qMin( C.nbytes, Cold.nbytes ) / C.chunkBytes,
+            ngood   = ChunkCrc::nMatching( C, Cold );
+
+    if( ngood < nchk ) {
+        Log() << QString("    Chunk %1 of '%2' changed since checkpoint;"
+                    " rescaling from start.")
+                    .arg( ngood ).arg( sbin );
+        return false;
+    }
+
+    return true;
+}
+
+
+// If -verify_src, get src meta's fileSHA1 into (want).
+//
+// Return true if src is to be verified.
+//
+bool Tool::do1_want_sha1( QString &want, const KVParams &kvp, const QString &s )
+{
+    if( !GBL.verify_src )
+        return false;
+
+    if( GBL.hasWindow() ) {
+        Log() << QString("    Can't verify a window's source '%1'.").arg( s );
+        return false;
+    }
+
+    want = kvp["fileSHA1"].toString().trimmed();
+
+    if( want.isEmpty() ) {
+        Log() << QString("    No fileSHA1; not verifying '%1'.").arg( s );
+        return false;
+    }
+
+    return true;
+}
+
+
+// Return true if src hash (H) matches meta.
+//
+bool Tool::do1_ok_sha1(
+    QCryptographicHash  &H,
+    const QString       &want,
+    const QString       &s )
+{
+    QString have = QString( H.result().toHex() );
+
+    if( have.compare( want, Qt::CaseInsensitive ) ) {
+
+        Log() << QString("Source SHA1 mismatch (meta %1, bin %2) '%3'.")
+                    .arg( want ).arg( have.toUpper() ).arg( s );
+        failWhy = "src SHA1 mismatch";
+        return false;
+    }
+
+    Log() << QString("    Verified source SHA1 '%1'.").arg( s );
+    return true;
+}
+
+
+// If -t0/-t1, limit (S) to the window, and fit the meta to it:
+// its duration, and firstSample of the first window sample.
+// Size and hash are set after scaling.
+//
+// Return true if no errors.
+//
+bool Tool::do1_window( Scaler &S, KVParams &kvp, const QString &s )
+{
+    if( !GBL.hasWindow() )
+        return true;
+
+    double  srate = kvp["niSampRate"].toDouble();
+    qint64  w0, w1;
+
+    if( !GBL.window( w0, w1, srate, S.tpts() ) || !S.setWindow( w0, w1 ) ) {
+        Log() << QString("Window [%1, %2) is empty for '%3'.")
+                    .arg( GBL.t0 ).arg( GBL.t1 ).arg( s );
+        failWhy = "empty window";
+        return false;
+    }
+
+    kvp["firstSample"]  = kvp["firstSample"].toLongLong() + w0;
+    kvp["fileTimeSecs"] = srate > 0 ? (w1 - w0) / srate : 0.0;
+
+    Log() << QString("    Window samples [%1, %2) of %3.")
+                .arg( w0 ).arg( w1 ).arg( s );
+
+    return true;
+}
+
+
+// If -chans, have (S) write only those of the saved channels,
+// via (G), and fit the meta's channel list to them. Channels
+// are acquired ids, as in snsSaveChanSubset; ids not saved in
+// this file are ignored.
+//
+// Return true if no errors.
+//
+bool Tool::do1_chans(
+    Scaler          &S,
+    Gather          &G,
+    KVParams        &kvp,
+    const QString   &s )
+{
+    if( GBL.chans.isEmpty() )
+        return true;
+
+    QVector<uint>   vSaved, iKeep, vKept;
+    QBitArray       b;
+    QString         chnstr  = kvp["snsSaveChanSubset"].toString();
+    int             nC      = kvp["nSavedChans"].toInt();
+
+    if( Subset::isAllChansStr( chnstr ) )
+        Subset::defaultVec( vSaved, nC );
+    else
+        Subset::rngStr2Vec( vSaved, chnstr );
+
+    Subset::rngStr2Bits( b, GBL.chans );
+
+    for( int i = 0, n = vSaved.size(); i < n; ++i ) {
+
+        if( int(vSaved[i]) < b.size() && b.testBit( vSaved[i] ) ) {
+            iKeep.push_back( i );
+            vKept.push_back( vSaved[i] );
+        }
+    }
+
+    if( vSaved.size() != nC || iKeep.isEmpty() ) {
+        Log() << QString("Channels [%1] not saved in '%2'.")
+                    .arg( GBL.chans ).arg( s );
+        failWhy = "no such channels";
+        return false;
+    }
+
+    G.make( iKeep, nC );
+
+    if( !S.setGather( &G ) ) {
+        Log() << QString("Channel count doesn't match meta '%1'.").arg( s );
+        return false;
+    }
+
+    if( !G.isAll() ) {
+        kvp["snsSaveChanSubset"]    = Subset::vec2RngStr( vKept );
+        kvp["nSavedChans"]          = G.nkeep;
+    }
+
+    Log() << QString("    Keeping %1 of %2 channels of %3.")
+                .arg( G.nkeep ).arg( nC ).arg( s );
+
+    return true;
+}
+
+
+// The dst meta carries the dst bin's hash and size, not the src's.
+//
+void Tool::do1_set_hash( KVParams &kvp, QCryptographicHash &H, qint64 bytes )
+{
+    kvp["fileSHA1"]         = QString( H.result().toHex().toUpper() );
+    kvp["fileSizeBytes"]    = bytes;
+}
+
+
+// Threads for chunked work (codecs): -threads, else all cores.
+//
+int Tool::workers()
+{
+    return GBL.threads > 1 ? GBL.threads : QThread::idealThreadCount();
+}
+
+
+// Record the run settings a progress entry is valid for.
+//
+void Tool::do1_set_prog_key( QSettings &prog, const QString &s )
+{
+    QString sbin = meta2bin( s ),
+            ssrc = srcIsCbin( s ) ? meta2ext( s, "cbin" ) : sbin;
+
+    prog.setValue( sbin + "/srcBytes", QFileInfo( GBL.src_dir + ssrc ).size() );
+    prog.setValue( sbin + "/window", GBL.sWindow() );
+    prog.setValue( sbin + "/chans", GBL.chans );
+    prog.setValue( sbin + "/format", GBL.compress ? "cbin" : "bin" );
+}
+
+
+// True if progress entry was made by a run with the same
+// settings, on the same src.
+//
+bool Tool::do1_ok_prog_key( QSettings &prog, const QString &s )
+{
+    QString sbin = meta2bin( s ),
+            ssrc = srcIsCbin( s ) ? meta2ext( s, "cbin" ) : sbin;
+
+    return prog.value( sbin + "/srcBytes", -1 ).toLongLong() ==
+            QFileInfo( GBL.src_dir + ssrc ).size()
+        && prog.value( sbin + "/window", "" ).toString() == GBL.sWindow()
+        && prog.value( sbin + "/chans", "" ).toString() == GBL.chans
+        && prog.value( sbin + "/format", "bin" ).toString() ==
+            (GBL.compress ? "cbin" : "bin");
+}
+
+
+// True if an earlier run, with the same settings, finished
+// this file and its output is still there.
+//
+bool Tool::do1_is_finished( QSettings &prog, const QString &s )
+{
+    QString sbin = meta2bin( s );
+
+    if( !prog.value( sbin + "/finished", false ).toBool()
+        || !do1_ok_prog_key( prog, s )
+        || !QFileInfo( GBL.dst_dir + s ).exists() ) {
+
+        return false;
+    }
+
+    if( GBL.compress ) {
+        return QFileInfo( GBL.dst_dir + meta2ext( s, "cbin" ) ).exists()
+            && QFileInfo( GBL.dst_dir + meta2ext( s, "ch" ) ).exists();
+    }
+
+    return QFileInfo( GBL.dst_dir + sbin ).exists()
+        && (!GBL.crc || QFileInfo( GBL.dst_dir + meta2ext( s, "crc" ) ).exists());
+}
+
+// True if src has no bin, but a .cbin/.ch pair instead.
+//
+bool Tool::srcIsCbin( const QString &s )
+{
+    return !QFileInfo( GBL.src_dir + meta2bin( s ) ).exists()
+        && QFileInfo( GBL.src_dir + meta2ext( s, "cbin" ) ).exists()
+        && QFileInfo( GBL.src_dir + meta2ext( s, "ch" ) ).exists();
+}
+
+
+QString Tool::journal( const QString &meta )
+{
+    return GBL.src_dir + meta2bin( meta ) + ".journal";
+}
+
+
+// Batch progress sidecar in dst_dir; per bin:
+// - srcBytes:  size of src bin when started.
+// - window, chans, format: output settings of that run.
+// - doneBytes: dst bytes scaled and synced to disk.
+// - finished:  dst bin and meta complete.
+//
+QString Tool::progFile()
+{
+    return GBL.dst_dir + "niscaler_progress.ini";
+}
+
+
+QString Tool::meta2bin( const QString &meta )
+{
+    return meta2ext( meta, "bin" );
+}
+
+
+QString Tool::meta2ext( const QString &meta, const QString &ext )
 {
     QRegExp re("meta$");
     re.setCaseSensitivity( Qt::CaseInsensitive );
 
-    return QString(meta).replace( re, "bin" );
+    return QString(meta).replace( re, ext );
 }
 
 
@@ -1,39 +1,22 @@
 #ifndef TOOL_H
 #define TOOL_H
 
-#include "KVParams.h"
+#include "Plan.h"
 
-#include <QSettings>
-
-#include <vector>
+class Scaler;
+class ChunkCrc;
+class Gather;
+class QCryptographicHash;
 
 /* ---------------------------------------------------------------- */
 /* Types ---------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
 
-struct Coeff {
-// Table of cal coeffs for given dev_product_voltage...
-// Addressed by physical NI channel.
-    int ncof;
-    std::vector<std::vector<double> >   V;
-    Coeff() : ncof(0)   {}
-    void get( QSettings &S, const QString &grpdev );
-};
-
-struct Plan {
-// At each timepoint...
-// Which {Coeff table, physical channel} to apply
-    double              V2I;    // volts -> i16
-    int                 nC,     // words/timepoint
-                        nai;    // vector size
-    std::vector<bool>   ic2K1;  // true if K1
-    std::vector<uint>   ic2ai;  // physical channel
-    void make( const KVParams &kvp );
-    void apply( qint16 *d, int ntpts, const Coeff &K1, const Coeff &K2 ) const;
-};
-
 class Tool
 {
+private:
+    QString failWhy;    // summary note for failed file
+
 public:
     virtual ~Tool() {}
 
@@ -42,9 +25,13 @@ public:
 private:
     bool createCal();
     void apply();
+    void applyStream();
+    void verifyCrc();
     bool okInput();
     bool enumSrc( QStringList &sl );
+    bool do1_is_finished( QSettings &prog, const QString &s );
     bool do1_ok_meta( KVParams &kvp, const QString &s );
+    bool do1_ok_version( const KVParams &kvp, const QString &s );
     bool do1_ok_coef(
         Coeff           &K1,
         Coeff           &K2,
@@ -52,12 +39,44 @@ private:
         const KVParams  &kvp,
         const QString   &s );
     bool do1_update_meta( const QString &s, KVParams &kvp );
-    void do1_scale(
+    bool do1_scale(
         const QString   &s,
         const Plan      &P,
-        const Coeff     &K1,
-        const Coeff     &K2 );
+        KVParams        &kvp,
+        QSettings       &prog );
+    bool do1_run( Scaler &S, int eng );
+    bool do1_window( Scaler &S, KVParams &kvp, const QString &s );
+    bool do1_chans(
+        Scaler          &S,
+        Gather          &G,
+        KVParams        &kvp,
+        const QString   &s );
+    bool do1_scale_in_place( const QString &s, const Plan &P, KVParams &kvp );
+    bool do1_compress( const QString &s, const Plan &P, KVParams &kvp );
+    bool do1_hash_file(
+        QCryptographicHash  &H,
+        ChunkCrc            *crc,
+        const QString       &bin,
+        qint64              offset,
+        qint64              bytes );
+    bool do1_ok_crc_done(
+        const ChunkCrc  &C,
+        const QString   &scrc,
+        const QString   &sbin );
+    bool do1_want_sha1( QString &want, const KVParams &kvp, const QString &s );
+    bool do1_ok_sha1(
+        QCryptographicHash  &H,
+        const QString       &want,
+        const QString       &s );
+    void do1_set_hash( KVParams &kvp, QCryptographicHash &H, qint64 bytes );
+    void do1_set_prog_key( QSettings &prog, const QString &s );
+    bool do1_ok_prog_key( QSettings &prog, const QString &s );
+    int workers();
+    bool srcIsCbin( const QString &s );
+    QString journal( const QString &meta );
+    QString progFile();
     QString meta2bin( const QString &meta );
+    QString meta2ext( const QString &meta, const QString &ext );
 };
 
 #endif  // TOOL_H
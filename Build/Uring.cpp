@@ -0,0 +1,293 @@
+
+
+#include "Uring.h"
+
+#if defined(Q_OS_LINUX) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_URING
+#endif
+#endif
+
+#ifdef HAVE_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+
+/* ---------------------------------------------------------------- */
+/* Uring ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+Uring::Uring()
+    :   fd(-1), depth(0), pending(0),
+        sqMap(0), cqMap(0), sqeMap(0),
+        sqLen(0), cqLen(0), sqeLen(0)
+{
+}
+
+
+#ifdef HAVE_URING
+
+// Ring indices are shared with the kernel: we read the index it
+// advances with acquire and publish our own with release.
+//
+#define RING_LOAD( p )      __atomic_load_n( p, __ATOMIC_ACQUIRE )
+#define RING_STORE( p, v )  __atomic_store_n( p, v, __ATOMIC_RELEASE )
+
+
+bool Uring::init( int depth )
+{
+    close();
+
+    struct io_uring_params  prm;
+
+    memset( &prm, 0, sizeof(prm) );
+
+    fd = syscall( __NR_io_uring_setup, depth, &prm );
+
+    if( fd < 0 ) {
+        fd = -1;
+        return false;
+    }
+
+// IORING_OP_READ/WRITE arrived in 5.6 along with this feature
+// flag; on older kernels fall back to blocking I/O.
+
+    if( !(prm.features & IORING_FEAT_RW_CUR_POS) ) {
+        close();
+        return false;
+    }
+
+    this->depth = prm.sq_entries;
+
+    sqLen   = prm.sq_off.array + prm.sq_entries * sizeof(uint);
+    cqLen   = prm.cq_off.cqes + prm.cq_entries * sizeof(io_uring_cqe);
+    sqeLen  = prm.sq_entries * sizeof(io_uring_sqe);
+
+    sqMap = mmap( 0, sqLen, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING );
+
+    if( sqMap == MAP_FAILED ) {
+        sqMap = 0;
+        close();
+        return false;
+    }
+
+    cqMap = mmap( 0, cqLen, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING );
+
+    if( cqMap == MAP_FAILED ) {
+        cqMap = 0;
+        close();
+        return false;
+    }
+
+    sqeMap = mmap( 0, sqeLen, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES );
+
+    if( sqeMap == MAP_FAILED ) {
+        sqeMap = 0;
+        close();
+        return false;
+    }
+
+    char    *sq = (char*)sqMap,
+            *cq = (char*)cqMap;
+
+    sqHead  = (uint*)(sq + prm.sq_off.head);
+    sqTail  = (uint*)(sq + prm.sq_off.tail);
+    sqMask  = (uint*)(sq + prm.sq_off.ring_mask);
+    sqArray = (uint*)(sq + prm.sq_off.array);
+    cqHead  = (uint*)(cq + prm.cq_off.head);
+    cqTail  = (uint*)(cq + prm.cq_off.tail);
+    cqMask  = (uint*)(cq + prm.cq_off.ring_mask);
+    sqes    = sqeMap;
+    cqes    = cq + prm.cq_off.cqes;
+    pending = 0;
+
+    return true;
+}
+
+
+void Uring::close()
+{
+    if( sqeMap )
+        munmap( sqeMap, sqeLen );
+
+    if( cqMap )
+        munmap( cqMap, cqLen );
+
+    if( sqMap )
+        munmap( sqMap, sqLen );
+
+    if( fd >= 0 )
+        ::close( fd );
+
+    fd      = -1;
+    sqMap   = 0;
+    cqMap   = 0;
+    sqeMap  = 0;
+}
+
+
+// Submit everything queued, then block until at least
+// (nwait) completions are available.
+//
+// Return count submitted, or -errno.
+//
+int Uring::submitAndWait( int nwait )
+{
+    for(;;) {
+
+        int ret = syscall( __NR_io_uring_enter, fd, pending, nwait,
+                    nwait ? IORING_ENTER_GETEVENTS : 0, 0, 0 );
+
+        if( ret >= 0 ) {
+            pending -= ret;
+            return ret;
+        }
+
+        if( errno != EINTR )
+            return -errno;
+    }
+}
+
+
+// Pop one completion if available.
+//
+bool Uring::reap( quint64 &tag, int &res )
+{
+    uint    head = *cqHead;
+
+    if( head == RING_LOAD( cqTail ) )
+        return false;
+
+    io_uring_cqe    *E = &((io_uring_cqe*)cqes)[head & *cqMask];
+
+    tag = E->user_data;
+    res = E->res;
+
+    RING_STORE( cqHead, head + 1 );
+
+    return true;
+}
+
+
+bool Uring::queue(
+    int         op,
+    int         fd,
+    const void  *buf,
+    uint        bytes,
+    qint64      offset,
+    quint64     tag )
+{
+    uint    tail = *sqTail;
+
+    if( tail - RING_LOAD( sqHead ) >= uint(depth) )
+        return false;
+
+    uint            idx = tail & *sqMask;
+    io_uring_sqe    *S  = &((io_uring_sqe*)sqes)[idx];
+
+    memset( S, 0, sizeof(io_uring_sqe) );
+    S->opcode       = op;
+    S->fd           = fd;
+    S->addr         = (quint64)buf;
+    S->len          = bytes;
+    S->off          = offset;
+    S->user_data    = tag;
+
+    sqArray[idx] = idx;
+    RING_STORE( sqTail, tail + 1 );
+    ++pending;
+
+    return true;
+}
+
+
+bool Uring::queueRead(
+    int     fd,
+    void    *buf,
+    uint    bytes,
+    qint64  offset,
+    quint64 tag )
+{
+    return queue( IORING_OP_READ, fd, buf, bytes, offset, tag );
+}
+
+
+bool Uring::queueWrite(
+    int         fd,
+    const void  *buf,
+    uint        bytes,
+    qint64      offset,
+    quint64     tag )
+{
+    return queue( IORING_OP_WRITE, fd, buf, bytes, offset, tag );
+}
+
+
+// Ask the kernel to cancel the request tagged (target). Both
+// complete: the request (often -ECANCELED) and this one, as
+// (tag), with 0, -ENOENT (already done) or -EALREADY.
+//
+bool Uring::queueCancel( quint64 target, quint64 tag )
+{
+    return queue( IORING_OP_ASYNC_CANCEL, -1, (const void*)target, 0, 0, tag );
+}
+
+#else
+
+bool Uring::init( int )
+{
+    return false;
+}
+
+
+void Uring::close()
+{
+}
+
+
+int Uring::submitAndWait( int )
+{
+    return -1;
+}
+
+
+bool Uring::reap( quint64 &, int & )
+{
+    return false;
+}
+
+
+bool Uring::queue( int, int, const void *, uint, qint64, quint64 )
+{
+    return false;
+}
+
+
+bool Uring::queueRead( int, void *, uint, qint64, quint64 )
+{
+    return false;
+}
+
+
+bool Uring::queueWrite( int, const void *, uint, qint64, quint64 )
+{
+    return false;
+}
+
+
+bool Uring::queueCancel( quint64, quint64 )
+{
+    return false;
+}
+
+#endif
+
+
@@ -0,0 +1,66 @@
+#ifndef URING_H
+#define URING_H
+
+#include <qglobal.h>
+
+/* ---------------------------------------------------------------- */
+/* Types ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Minimal Linux io_uring queue using raw syscalls (no liburing).
+//
+// Caller queues positional reads and writes tagged with an id,
+// submits them in one system call, then reaps completions in any
+// order. Each completion carries the tag and the kernel result
+// (bytes transferred or -errno).
+//
+// Closing the ring does not wait for queued requests; callers
+// must reap (or cancel and reap) all of them before releasing
+// their buffers.
+//
+// On other platforms, or kernels/sandboxes without io_uring,
+// init() returns false and the caller should use blocking I/O.
+//
+class Uring
+{
+private:
+    int     fd,
+            depth;
+    uint    pending;    // queued, not yet submitted
+    void    *sqMap,
+            *cqMap,
+            *sqeMap;
+    qint64  sqLen,
+            cqLen,
+            sqeLen;
+    uint    *sqHead,
+            *sqTail,
+            *sqMask,
+            *sqArray,
+            *cqHead,
+            *cqTail,
+            *cqMask;
+    void    *sqes,
+            *cqes;
+
+public:
+    Uring();
+    ~Uring()    {close();}
+
+    bool init( int depth );
+    void close();
+
+    bool queueRead( int fd, void *buf, uint bytes, qint64 offset, quint64 tag );
+    bool queueWrite( int fd, const void *buf, uint bytes, qint64 offset, quint64 tag );
+    bool queueCancel( quint64 target, quint64 tag );
+
+    int submitAndWait( int nwait );
+    bool reap( quint64 &tag, int &res );
+
+private:
+    bool queue( int op, int fd, const void *buf, uint bytes, qint64 offset, quint64 tag );
+};
+
+#endif  // URING_H
+
+
@@ -108,6 +108,34 @@ QString calibPath( const QString &fileName );
 // Full path to tool item
 bool toolPath( QString &path, const QString &toolName, bool bcreate );
 
+/* ---------------------------------------------------------------- */
+/* Files ---------------------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+// Read/write (bytes) at absolute (offset) without moving the
+// file position; safe to call from several threads at once.
+// Open (f) Unbuffered. Return count transferred, or -1 on error.
+qint64 readAt( QFile &f, char *buf, qint64 bytes, qint64 offset );
+qint64 writeAt( QFile &f, const char *buf, qint64 bytes, qint64 offset );
+
+// Reopen (f) by its fileName() with page cache bypassed
+// (O_DIRECT, F_NOCACHE, FILE_FLAG_NO_BUFFERING). Transfers
+// must then be sector aligned in address, offset and length.
+bool openDirect( QFile &f, QIODevice::OpenMode mode );
+
+// Reserve disk extents for (bytes); false if not supported.
+bool preallocate( QFile &f, qint64 bytes );
+
+// Block until written data of (f) is on stable storage.
+bool syncFile( QFile &f );
+
+// Ready stdin/stdout (fd) for bulk binary data: binary mode
+// on Windows, enlarged kernel buffer if (fd) is a Linux pipe.
+void prepStdPipe( int fd );
+
+// Hint that mapped range [p, p+bytes) will be read once, in order.
+void adviseSequential( const uchar *p, qint64 bytes );
+
 /* ---------------------------------------------------------------- */
 /* Timers --------------------------------------------------------- */
 /* ---------------------------------------------------------------- */
@@ -15,6 +15,8 @@
 
 #ifdef Q_OS_WIN
     #include <windows.h>
+    #include <io.h>
+    #include <fcntl.h>
     #include <QDir>
 #elif defined(Q_WS_X11)
     #include <GL/gl.h>
@@ -47,6 +49,10 @@
 #endif
 
 #if !defined(Q_OS_WIN)
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
     #include <sys/socket.h>
     #include <netinet/in.h>
     #include <netinet/tcp.h>
@@ -59,6 +65,295 @@
 
 namespace Util {
 
+/* ---------------------------------------------------------------- */
+/* readAt, writeAt ------------------------------------------------ */
+/* ---------------------------------------------------------------- */
+
+#ifdef Q_OS_WIN
+
+qint64 readAt( QFile &f, char *buf, qint64 bytes, qint64 offset )
+{
+    HANDLE  h       = (HANDLE)_get_osfhandle( f.handle() );
+    qint64  done    = 0;
+
+    while( done < bytes ) {
+
+        OVERLAPPED  ov;
+        DWORD       got = 0;
+        qint64      off = offset + done;
+
+        memset( &ov, 0, sizeof(ov) );
+        ov.Offset       = DWORD(off & 0xFFFFFFFF);
+        ov.OffsetHigh   = DWORD(off >> 32);
+
+        if( !ReadFile( h, buf + done,
+                DWORD(qMin( bytes - done, qint64(1 << 30) )),
+                &got, &ov ) ) {
+
+            if( GetLastError() == ERROR_HANDLE_EOF )
+                break;
+
+            return -1;
+        }
+
+        if( !got )
+            break;
+
+        done += got;
+    }
+
+    return done;
+}
+
+
+qint64 writeAt( QFile &f, const char *buf, qint64 bytes, qint64 offset )
+{
+    HANDLE  h       = (HANDLE)_get_osfhandle( f.handle() );
+    qint64  done    = 0;
+
+    while( done < bytes ) {
+
+        OVERLAPPED  ov;
+        DWORD       put = 0;
+        qint64      off = offset + done;
+
+        memset( &ov, 0, sizeof(ov) );
+        ov.Offset       = DWORD(off & 0xFFFFFFFF);
+        ov.OffsetHigh   = DWORD(off >> 32);
+
+        if( !WriteFile( h, buf + done,
+                DWORD(qMin( bytes - done, qint64(1 << 30) )),
+                &put, &ov ) ) {
+
+            return -1;
+        }
+
+        done += put;
+    }
+
+    return done;
+}
+
+#else
+
+qint64 readAt( QFile &f, char *buf, qint64 bytes, qint64 offset )
+{
+    int     fd      = f.handle();
+    qint64  done    = 0;
+
+    while( done < bytes ) {
+
+        ssize_t got = pread( fd, buf + done, bytes - done, offset + done );
+
+        if( got < 0 ) {
+
+            if( errno == EINTR )
+                continue;
+
+            return -1;
+        }
+
+        if( !got )
+            break;
+
+        done += got;
+    }
+
+    return done;
+}
+
+
+qint64 writeAt( QFile &f, const char *buf, qint64 bytes, qint64 offset )
+{
+    int     fd      = f.handle();
+    qint64  done    = 0;
+
+    while( done < bytes ) {
+
+        ssize_t put = pwrite( fd, buf + done, bytes - done, offset + done );
+
+        if( put < 0 ) {
+
+            if( errno == EINTR )
+                continue;
+
+            return -1;
+        }
+
+        done += put;
+    }
+
+    return done;
+}
+
+#endif
+
+/* ---------------------------------------------------------------- */
+/* openDirect, preallocate, syncFile, prepStdPipe ----------------- */
+/* ---------------------------------------------------------------- */
+
+#ifdef Q_OS_WIN
+
+bool openDirect( QFile &f, QIODevice::OpenMode mode )
+{
+    bool    wr  = mode & QIODevice::WriteOnly,
+            rw  = (mode & QIODevice::ReadWrite) == QIODevice::ReadWrite;
+    DWORD   acc = (rw ? GENERIC_READ | GENERIC_WRITE :
+                    (wr ? GENERIC_WRITE : GENERIC_READ)),
+            how = OPEN_EXISTING;
+
+    if( wr ) {
+        how = (!rw || (mode & QIODevice::Truncate) ?
+                CREATE_ALWAYS : OPEN_ALWAYS);
+    }
+
+    HANDLE  h   = CreateFileW(
+                    (LPCWSTR)f.fileName().utf16(),
+                    acc,
+                    FILE_SHARE_READ,
+                    NULL,
+                    how,
+                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING
+                    | (wr ? FILE_FLAG_WRITE_THROUGH : 0),
+                    NULL );
+
+    if( h == INVALID_HANDLE_VALUE )
+        return false;
+
+    int fd = _open_osfhandle( (intptr_t)h, wr ? 0 : _O_RDONLY );
+
+    if( fd < 0 ) {
+        CloseHandle( h );
+        return false;
+    }
+
+    return f.open( fd, mode | QIODevice::Unbuffered, QFileDevice::AutoCloseHandle );
+}
+
+
+bool preallocate( QFile &f, qint64 bytes )
+{
+    FILE_ALLOCATION_INFO    info;
+
+    info.AllocationSize.QuadPart = bytes;
+
+    return SetFileInformationByHandle(
+            (HANDLE)_get_osfhandle( f.handle() ),
+            FileAllocationInfo, &info, sizeof(info) );
+}
+
+
+bool syncFile( QFile &f )
+{
+    return f.flush()
+            && FlushFileBuffers( (HANDLE)_get_osfhandle( f.handle() ) );
+}
+
+
+void prepStdPipe( int fd )
+{
+    _setmode( fd, _O_BINARY );
+}
+
+#else
+
+bool openDirect( QFile &f, QIODevice::OpenMode mode )
+{
+    int flags = O_RDONLY;
+
+    if( (mode & QIODevice::ReadWrite) == QIODevice::ReadWrite ) {
+
+        flags = O_RDWR | O_CREAT;
+
+        if( mode & QIODevice::Truncate )
+            flags |= O_TRUNC;
+    }
+    else if( mode & QIODevice::WriteOnly )
+        flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+#ifdef O_DIRECT
+    flags |= O_DIRECT;
+#endif
+
+    int fd = ::open( f.fileName().toLocal8Bit().constData(), flags, 0644 );
+
+    if( fd < 0 )
+        return false;
+
+#ifdef F_NOCACHE
+    fcntl( fd, F_NOCACHE, 1 );
+#endif
+
+    if( !f.open( fd, mode | QIODevice::Unbuffered, QFileDevice::AutoCloseHandle ) ) {
+        ::close( fd );
+        return false;
+    }
+
+    return true;
+}
+
+
+bool preallocate( QFile &f, qint64 bytes )
+{
+#ifdef Q_OS_LINUX
+    return !fallocate( f.handle(), 0, 0, bytes );
+#else
+    Q_UNUSED( f );
+    Q_UNUSED( bytes );
+    return false;
+#endif
+}
+
+
+bool syncFile( QFile &f )
+{
+    if( !f.flush() )
+        return false;
+
+#ifdef Q_OS_LINUX
+    return !fdatasync( f.handle() );
+#else
+    return !fsync( f.handle() );
+#endif
+}
+
+
+void prepStdPipe( int fd )
+{
+#if defined(Q_OS_LINUX) && defined(F_SETPIPE_SZ)
+// Best effort; capped by /proc/sys/fs/pipe-max-size
+    fcntl( fd, F_SETPIPE_SZ, 1024*1024 );
+#else
+    Q_UNUSED( fd );
+#endif
+}
+
+#endif
+
+/* ---------------------------------------------------------------- */
+/* adviseSequential ----------------------------------------------- */
+/* ---------------------------------------------------------------- */
+
+#ifdef Q_OS_WIN
+
+void adviseSequential( const uchar *, qint64 )
+{
+}
+
+#else
+
+void adviseSequential( const uchar *p, qint64 bytes )
+{
+// madvise wants a page-aligned start
+
+    quintptr    pg = sysconf( _SC_PAGESIZE ),
+                a0 = quintptr(p) & ~(pg - 1);
+
+    madvise( (void*)a0, quintptr(p) + bytes - a0, MADV_SEQUENTIAL );
+}
+
+#endif
+
 /* ---------------------------------------------------------------- */
 /* getTime -------------------------------------------------------- */
 /* ---------------------------------------------------------------- */